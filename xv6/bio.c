@@ -1,7 +1,9 @@
 // Buffer cache.
 //
 // The buffer cache is a linked list of buf structures holding
-// cached copies of disk block contents.  Caching disk blocks
+// cached copies of disk block contents.  It starts with NBUF
+// buffers and takes more from the buffer object cache when all
+// of them are busy or dirty.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
 // 
@@ -12,6 +14,8 @@
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
+// * To have a block read in before it is needed, call breadahead;
+//     the buffer is released by the disk driver when the read is done.
 // 
 // The implementation uses three state flags internally:
 // * B_BUSY: the block has been returned from bread
@@ -28,31 +32,48 @@
 
 struct {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  struct kcache *cache;
+  int nbuf;
 
   // Linked list of all buffers, through prev/next.
   // head.next is most recently used.
   struct buf head;
 } bcache;
 
+// Add a new buffer at the head of the list. Caller holds bcache.lock.
+static struct buf*
+bnew(void)
+{
+  struct buf *b;
+
+  if((b = kcachealloc(bcache.cache)) == 0)
+    return 0;
+  b->flags = 0;
+  b->dev = -1;
+  b->qnext = 0;
+  b->next = bcache.head.next;
+  b->prev = &bcache.head;
+  bcache.head.next->prev = b;
+  bcache.head.next = b;
+  bcache.nbuf++;
+  return b;
+}
+
 void
 binit(void)
 {
-  struct buf *b;
+  int i;
 
   initlock(&bcache.lock, "bcache");
+  bcache.cache = kcachecreate("buf", sizeof(struct buf), 0);
 
 //PAGEBREAK!
   // Create linked list of buffers
   bcache.head.prev = &bcache.head;
   bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    b->dev = -1;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
+  for(i = 0; i < NBUF; i++)
+    if(bnew() == 0)
+      panic("binit");
 }
 
 // Look through buffer cache for sector on device dev.
@@ -78,17 +99,18 @@ bget(uint dev, uint sector)
     }
   }
 
-  // Not cached; recycle some non-busy and clean buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if((b->flags & B_BUSY) == 0 && (b->flags & B_DIRTY) == 0){
-      b->dev = dev;
-      b->sector = sector;
-      b->flags = B_BUSY;
-      release(&bcache.lock);
-      return b;
-    }
-  }
-  panic("bget: no buffers");
+  // Not cached; recycle some non-busy and clean buffer,
+  // or make another.
+  for(b = bcache.head.prev; b != &bcache.head; b = b->prev)
+    if((b->flags & B_BUSY) == 0 && (b->flags & B_DIRTY) == 0)
+      break;
+  if(b == &bcache.head && (b = bnew()) == 0)
+    panic("bget: no buffers");
+  b->dev = dev;
+  b->sector = sector;
+  b->flags = B_BUSY;
+  release(&bcache.lock);
+  return b;
 }
 
 // Return a B_BUSY buf with the contents of the indicated disk sector.
@@ -102,6 +124,42 @@ bread(uint dev, uint sector)
   return b;
 }
 
+// Start reading the indicated disk sector into the cache without
+// waiting for it. Does nothing if the sector is cached already, or if
+// that would leave fewer than half the buffers free: a read-ahead must
+// not take the buffer that a later bget needs.
+void
+breadahead(uint dev, uint sector)
+{
+  struct buf *b, *victim;
+  int nfree;
+
+  acquire(&bcache.lock);
+  victim = 0;
+  nfree = 0;
+  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
+    if(b->dev == dev && b->sector == sector){
+      release(&bcache.lock);
+      return;
+    }
+    if((b->flags & B_BUSY) == 0 && (b->flags & B_DIRTY) == 0){
+      if(victim == 0)
+        victim = b;
+      nfree++;
+    }
+  }
+  if(nfree <= bcache.nbuf/2){
+    release(&bcache.lock);
+    return;
+  }
+  b = victim;
+  b->dev = dev;
+  b->sector = sector;
+  b->flags = B_BUSY|B_ASYNC;
+  release(&bcache.lock);
+  iderw(b);
+}
+
 // Write b's contents to disk.  Must be B_BUSY.
 void
 bwrite(struct buf *b)
@@ -195,6 +195,8 @@ consoleintr(int (*getc)(void))
     switch(c){
     case C('P'):  // Process listing.
       procdump();
+      kallocdump();
+      kcachedump();
       break;
     case C('U'):  // Kill line.
       while(input.e != input.w &&
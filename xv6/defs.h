@@ -2,6 +2,8 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct iovec;
+struct kcache;
 struct pipe;
 struct proc;
 struct spinlock;
@@ -12,6 +14,7 @@ struct sfs_inode;
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+void            breadahead(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
 
@@ -30,8 +33,14 @@ void            fileclose(struct file*);
 struct file*    filedup(struct file*);
 void            fileinit(void);
 int             fileread(struct file*, char*, int n);
+int             filereadv(struct file*, struct iovec*, int cnt);
+int             filegetdents(struct file*, char*, int n);
+int             filepread(struct file*, char*, int n, uint off);
+int             filepwrite(struct file*, char*, int n, uint off);
+int             fileseek(struct file*, int off, int whence);
 int             filestat(struct file*, struct stat*);
 int             filewrite(struct file*, char*, int n);
+int             filewritev(struct file*, struct iovec*, int cnt);
 
 // sfs_inode.c
 void            sfs_iinit(void);
@@ -40,10 +49,27 @@ void            readsb(int dev, struct sfs_super *sb);
 // fat_inode.c
 void            fat_iinit(void);
 
+// inode.c
+void            icache_init(void);
+
+// dcache.c
+void            dcache_init(void);
+
+// pcache.c
+void            pcache_init(void);
+char*           pcache_map(struct inode*, uint, int);
+void            pcache_dup(char*);
+void            pcache_unmap(char*);
+
+// mount.c
+void            vfs_init(void);
+void            vfs_mount_boot(void);
+
 // ide.c
 void            ideinit(void);
 void            ideintr(void);
 void            iderw(struct buf*);
+int             idepresent(uint);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
@@ -52,10 +78,25 @@ void            ioapicinit(void);
 
 // kalloc.c
 char*           kalloc(void);
+char*           kzalloc(void);
+void            kzeroidle(void);
+char*           kallocpages(int);
+void            kfreepages(char*, int);
+void            kallocdump(void);
 void            kfree(char*);
+void            kdup(char*);
+int             krefs(char*);
+int             kfreecount(void);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
 
+// slab.c
+#define KC_KEEP         0x1  // kcachecreate: never give memory back
+struct kcache*  kcachecreate(char*, uint, int);
+void*           kcachealloc(struct kcache*);
+void            kcachefree(struct kcache*, void*);
+void            kcachedump(void);
+
 // kbd.c
 void            kbdintr(void);
 
@@ -84,6 +125,7 @@ void            picenable(int);
 void            picinit(void);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, char*, int);
@@ -131,6 +173,7 @@ char*           strncpy(char*, const char*, int);
 // syscall.c
 int             argint(int, int*);
 int             argptr(int, char**, int);
+int             argwptr(int, char**, int);
 int             argstr(int, char**);
 int             fetchint(uint, int*);
 int             fetchstr(uint, char**);
@@ -166,6 +209,12 @@ void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
+int             vmfault(uint, int);
+int             uvmaccess(uint, uint, int);
+int             mmap(struct file*, uint, int, int, uint);
+int             munmap(uint, uint);
+void            munmapall(void);
+int             copyvmas(struct proc*);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
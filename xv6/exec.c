@@ -6,6 +6,8 @@
 #include "defs.h"
 #include "x86.h"
 #include "elf.h"
+#include "fcntl.h"
+#include "file.h"
 #include "vfs.h"
 #include "inode.h"
 
@@ -18,6 +20,9 @@ exec(char *path, char **argv)
   struct elfhdr elf;
   struct inode *ip;
   struct proghdr ph;
+  struct vma img[NVMA], *v;
+  struct file *f;
+  int nimg;
   pde_t *pgdir, *oldpgdir;
 //  cprintf("enter lookup1\n");
   if((ip = vfs_lookup(path)) == 0)
@@ -25,8 +30,10 @@ exec(char *path, char **argv)
     return -1;
   }
 //  cprintf("enter lookup2, iptype = %d\n",ip->fstype);
-  vop_ilock(ip);
+  vop_ilock_shared(ip);
   pgdir = 0;
+  f = 0;
+  nimg = 0;
 //  cprintf("enter lookup2.5\n");
   // Check ELF header
   if(vop_read(ip, (char*)&elf, 0, sizeof(elf)) < sizeof(elf))
@@ -43,8 +50,41 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.type != ELF_PROG_LOAD)
       continue;
-    if(ph.memsz < ph.filesz)
+    if(ph.memsz < ph.filesz || ph.vaddr + ph.memsz < ph.vaddr || ph.vaddr + ph.memsz >= KERNBASE)
       goto bad;
+    if(ph.vaddr % PGSIZE == ph.off % PGSIZE && ph.vaddr >= PGROUNDUP(sz) && nimg < NVMA){
+      // Map the segment, to be faulted in from the page
+      // cache: text pages are shared by every process
+      // running the program, and data pages until stored to.
+      if(f == 0){
+        if((f = filealloc()) == 0)
+          goto bad;
+        f->type = FD_INODE;
+        f->ip = vop_ref_inc(ip);
+        f->readable = 1;
+        f->writable = 0;
+        f->append = 0;
+        f->off = 0;
+      }
+      v = &img[nimg++];
+      v->start = PGROUNDDOWN(ph.vaddr);
+      v->end = PGROUNDUP(ph.vaddr + ph.memsz);
+      v->prot = PROT_READ;
+      if(ph.flags & ELF_PROG_FLAG_WRITE)
+        v->prot |= PROT_WRITE;
+      v->flags = MAP_PRIVATE;
+      v->off = ph.off - (ph.vaddr - v->start);
+      // Without a bss to zero, the rest of the last page
+      // may show the file as well, so that it too can come
+      // from the cache.
+      if(ph.memsz == ph.filesz)
+        v->filesz = v->end - v->start;
+      else
+        v->filesz = ph.filesz + (ph.vaddr - v->start);
+      v->f = filedup(f);
+      sz = v->end;
+      continue;
+    }
     if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
       goto bad;
     if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
@@ -53,6 +93,10 @@ exec(char *path, char **argv)
 //  cprintf("enter lookup4\n");
   vop_iunlockput(ip);
   ip = 0;
+  if(f){
+    fileclose(f);
+    f = 0;
+  }
   // Allocate two pages at the next page boundary.
   // Make the first inaccessible.  Use the second as the user stack.
   sz = PGROUNDUP(sz);
@@ -85,6 +129,9 @@ exec(char *path, char **argv)
   safestrcpy(proc->name, last, sizeof(proc->name));
 //  cprintf("enter lookup4\n");
   // Commit to the user image.
+  munmapall();
+  for(i = 0; i < nimg; i++)
+    proc->vma[i] = img[i];
   oldpgdir = proc->pgdir;
   proc->pgdir = pgdir;
   proc->sz = sz;
@@ -100,5 +147,9 @@ exec(char *path, char **argv)
     freevm(pgdir);
   if(ip)
     vop_iunlockput(ip);
+  for(i = 0; i < nimg; i++)
+    fileclose(img[i].f);
+  if(f)
+    fileclose(f);
   return -1;
 }
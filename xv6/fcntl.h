@@ -2,3 +2,24 @@
 #define O_WRONLY  0x001
 #define O_RDWR    0x002
 #define O_CREATE  0x200
+#define O_APPEND  0x400
+
+// lseek
+#define SEEK_SET  0
+#define SEEK_CUR  1
+#define SEEK_END  2
+
+// mmap
+#define PROT_READ   0x1
+#define PROT_WRITE  0x2
+#define MAP_SHARED  0x1  // stores reach the file
+#define MAP_PRIVATE 0x2  // stores are private to the process
+#define MAP_FAILED  ((void*)-1)
+
+// readv, writev
+#define IOV_MAX   16  // most segments per call
+
+struct iovec {
+  void *iov_base;
+  uint iov_len;
+};
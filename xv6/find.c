@@ -0,0 +1,48 @@
+// Simple find.  find [dir] [-name pattern] [-type d|f|c]
+// The pattern may use * and ?.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+char buf[1024];
+
+int
+main(int argc, char *argv[])
+{
+  struct findcursor cur;
+  char *path, *pat, *p;
+  int i, n, type;
+
+  path = ".";
+  pat = "*";
+  type = 0;
+  i = 1;
+  if(i < argc && argv[i][0] != '-')
+    path = argv[i++];
+  for(; i + 1 < argc; i += 2){
+    if(strcmp(argv[i], "-name") == 0)
+      pat = argv[i+1];
+    else if(strcmp(argv[i], "-type") == 0 && strcmp(argv[i+1], "d") == 0)
+      type = T_DIR;
+    else if(strcmp(argv[i], "-type") == 0 && strcmp(argv[i+1], "f") == 0)
+      type = T_FILE;
+    else if(strcmp(argv[i], "-type") == 0 && strcmp(argv[i+1], "c") == 0)
+      type = T_DEV;
+    else
+      break;
+  }
+  if(i < argc){
+    printf(2, "usage: find [dir] [-name pattern] [-type d|f|c]\n");
+    exit();
+  }
+
+  memset(&cur, 0, sizeof(cur));
+  while((n = find(path, pat, type, buf, sizeof(buf), &cur)) > 0){
+    for(p = buf; p < buf + n; p += strlen(p) + 1)
+      printf(1, "%s\n", p);
+  }
+  if(n < 0)
+    printf(2, "find: cannot search %s\n", path);
+  exit();
+}
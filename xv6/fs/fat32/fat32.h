@@ -1 +1,18 @@
-struct inode *fat_get_root();//added 12.27
\ No newline at end of file
+#ifndef FAT32_H
+#define FAT32_H
+
+#include "fat_inode.h"
+
+// In-memory state of a mounted FAT volume.
+struct fat_fs {
+  uint dev;
+  int valid;
+  struct BPB bpb;     // copy of the BIOS Parameter Block
+};
+
+struct fat_fs *fat_getfs(uint dev);
+int fat_mount(uint dev);
+void fat_unmount(uint dev);
+struct inode *fat_get_root(uint dev);//added 12.27
+
+#endif
@@ -3,21 +3,62 @@
 #include "param.h"
 #include "stat.h"
 #include "mmu.h"
+#include "buf.h"
 #include "fat32.h"
 #include "fat_inode.h"
 #include "param.h"
 #include "inode.h"
 
+static struct fat_fs fat_fs[NFAT];
+
+// Return the state of the mounted FAT volume on device dev.
+struct fat_fs *
+fat_getfs(uint dev)
+{
+	struct fat_fs *fs;
+
+	for(fs = fat_fs; fs < &fat_fs[NFAT]; fs++)
+		if(fs->valid && fs->dev == dev)
+			return fs;
+	panic("fat_getfs: not mounted");
+}
+
+// Read the BPB of device dev and keep it for the cluster
+// arithmetic, which used to re-read sector 0 on every call.
+// Mounts are serialized by the VFS.
+int
+fat_mount(uint dev)
+{
+	struct fat_fs *fs;
+	struct buf *bp;
+	struct BPB *bpb;
+
+	for(fs = fat_fs; fs < &fat_fs[NFAT]; fs++)
+		if(!fs->valid)
+			break;
+	if(fs == &fat_fs[NFAT])
+		return -1;
+	bp = bread(dev, 0);
+	memmove(&fs->bpb, bp->data, sizeof(fs->bpb));
+	brelse(bp);
+	bpb = &fs->bpb;
+	if(bpb->BytsPerSec != SECTSIZE || bpb->SecPerClus == 0 ||
+	   bpb->NumFATs == 0 || bpb->FATSz32 == 0)
+		return -1;
+	fs->dev = dev;
+	fs->valid = 1;
+	return 0;
+}
+
+void
+fat_unmount(uint dev)
+{
+	fat_getfs(dev)->valid = 0;
+}
+
 struct inode *
-fat_get_root(){
-//	cprintf("enter fat_get_root\n");
-	struct inode *node;
-	int fat_rootdev_num = 2;// set as 2...
-//	cprintf("before fat_iget\n");
-	node = fat_iget(fat_rootdev_num, 2, T_DIR,0);
-//	struct fat_inode *sin = vop_info(node, fat_inode);
-//	cprintf("inum = %d\n", sin->inum);
-	return node;
+fat_get_root(uint dev){
+	return fat_iget(dev, 2, T_DIR, 0);
 }
 
-// this file added 12.25
\ No newline at end of file
+// this file added 12.25
@@ -21,14 +21,13 @@ static void fat_ilock(struct inode *ip);
 static void fat_iunlock(struct inode *ip);
 static const struct inode_ops fat_node_dirops;//modified 12.27
 static const struct inode_ops fat_node_fileops;
-extern struct icache_universal icache;//added 12.25
 
 // struct {
 //   struct spinlock lock;
 //   struct inode inode[NINODE];
 // } icache;//removed 12.25
 
-// icache now is defined and externed in sfs_inode.c
+// icache now is defined in fs/vfs/inode.c and shared with sfs
 
 /*
  * fat_get_ops - return function addr of fat_node_dirops/fat_node_fileops
@@ -84,17 +83,21 @@ fat_mapType(short type)
   return attr;
 }
 
+// Format an 11-byte short name as "NAME.EXT", without the padding.
 void
 copyshortname(char *dst, char *src)
 {
-  int i;
-  for (i = 0; i != 11; ++i) {
-    if (*src == 0x20)
-      continue;
-    *dst++ = *src++;
-    if (i == 7)
-      *dst++ = '.';
-  }
+  int i, n;
+  for (n = 8; n > 0 && src[n - 1] == 0x20; --n)
+    ;
+  for (i = 0; i < n; ++i)
+    *dst++ = src[i];
+  for (n = 11; n > 8 && src[n - 1] == 0x20; --n)
+    ;
+  if (n > 8)
+    *dst++ = '.';
+  for (i = 8; i < n; ++i)
+    *dst++ = src[i];
   *dst++ = 0;
 }
 
@@ -191,27 +194,16 @@ fat_getDIRType(struct LDIR* ldir)
     }
 }
 
-// Read the BPB.
-static void
-fat_readbpb(int dev, struct BPB *bpb)
-{
-  struct buf *bp;
-  bp = bread(dev, 0);
-  memmove(bpb, bp->data, sizeof(*bpb));
-//  cprintf("fat_readbpb, dev = %d, data[0] = %d, data[1] = %d, data[10] = %d, NumFATs=%d\n", dev, bp->data[0], bp->data[1], bp->data[10], bpb->NumFATs);
-  brelse(bp);
-}
-
 // Update other FATs
 void
 fat_updateFATs(struct buf *sp)
 {
   struct buf *tp;
-  struct BPB bpb;
+  struct BPB *bpb;
   int i, off;
   
-  fat_readbpb(sp->dev, &bpb);
-  for (i = 1, off = bpb.FATSz32; i < bpb.NumFATs; ++i, off += bpb.FATSz32) {
+  bpb = &fat_getfs(sp->dev)->bpb;
+  for (i = 1, off = bpb->FATSz32; i < bpb->NumFATs; ++i, off += bpb->FATSz32) {
     tp = bread(sp->dev, sp->sector + off);
     memmove(tp->data, sp->data, 512);
     bwrite(tp);
@@ -227,20 +219,20 @@ fat_calloc(uint dev)
 {
   uint c, cursect, lastsect, secOff;
   struct buf *bp, *bfsi;
-  struct BPB bpb;
+  struct BPB *bpb;
   struct FSI *fsi;
 
-  fat_readbpb(dev, &bpb);
-  bfsi = bread(dev, bpb.FSInfo);
+  bpb = &fat_getfs(dev)->bpb;
+  bfsi = bread(dev, bpb->FSInfo);
   fsi = (struct FSI*)bfsi->data;  
 //  cprintf("enter fatcalloc, dev = %d\n", dev);
   // Look for an empty cluster from fsi.Nxt_Free.
   bp = 0;
   lastsect = 0;
-//  cprintf("Nxt_Free = %d, TotSec32 = %d, SecPerClus = %d\n", fsi->Nxt_Free, bpb.TotSec32, bpb.SecPerClus);
-  for(c = fsi->Nxt_Free; c < bpb.TotSec32 / bpb.SecPerClus; ++c){
+//  cprintf("Nxt_Free = %d, TotSec32 = %d, SecPerClus = %d\n", fsi->Nxt_Free, bpb->TotSec32, bpb->SecPerClus);
+  for(c = fsi->Nxt_Free; c < bpb->TotSec32 / bpb->SecPerClus; ++c){
 //    cprintf("cluster number = %d\n", c);
-    cursect = fat_getFATEntry(&bpb, c, &secOff);
+    cursect = fat_getFATEntry(bpb, c, &secOff);
  //   cprintf("cluster number1 = %d\n", c);
     if (cursect != lastsect){ // Is this sector in memory?
       if (bp){
@@ -269,7 +261,7 @@ fat_calloc(uint dev)
 //  cprintf("calloc: cannot find\n");
   // Cannot find a free cluster from Nxt_Free.
   for(c = 2; c < fsi->Nxt_Free; ++c){
-    cursect = fat_getFATEntry(&bpb, c, &secOff);
+    cursect = fat_getFATEntry(bpb, c, &secOff);
     if (cursect != lastsect){ // Is this sector in memory?
       if (bp)
         brelse(bp);
@@ -300,12 +292,12 @@ void
 fat_cclear(uint dev, uint cluster)
 {
   struct buf *cp;
-  struct BPB bpb;
+  struct BPB *bpb;
   int i, sec;
   
-  fat_readbpb(dev, &bpb);
-  sec = fat_getFirstSectorofCluster(&bpb, cluster);
-  for (i = 0; i < bpb.SecPerClus; ++i) {
+  bpb = &fat_getfs(dev)->bpb;
+  sec = fat_getFirstSectorofCluster(bpb, cluster);
+  for (i = 0; i < bpb->SecPerClus; ++i) {
  //   cprintf("before bread3 dev = %d, cursect = %d\n", dev, sec+i);
     cp = bread(dev, sec + i);
     memset(cp->data, 0, sizeof(cp->data));
@@ -330,14 +322,14 @@ fat_iupdate(struct inode *ip)
   uint curFatsect, lastFatsect = 0, secOff;
   uint si, s, cno = sin->dircluster;
   struct buf *fp, *sp;
-  struct BPB bpb;
+  struct BPB *bpb;
   struct DIR *de;
 //  cprintf("iupdate1 \n");
-  fat_readbpb(sin->dev, &bpb);
+  bpb = &fat_getfs(sin->dev)->bpb;
   fp = 0;
   do {
-    s = fat_getFirstSectorofCluster(&bpb, cno);
-    for (si = 0; si < bpb.SecPerClus; ++si) {   // Every sector
+    s = fat_getFirstSectorofCluster(bpb, cno);
+    for (si = 0; si < bpb->SecPerClus; ++si) {   // Every sector
   //    cprintf("before bread4 cursect = %d\n", s+si);
       sp = bread(sin->dev, s + si);
  //     cprintf("iupdate2 data = %d\n", sp->data);
@@ -368,7 +360,7 @@ fat_iupdate(struct inode *ip)
     }
 //    cprintf("iupdate4 \n");
     // Find FAT entry
-    curFatsect = fat_getFATEntry(&bpb, cno, &secOff);
+    curFatsect = fat_getFATEntry(bpb, cno, &secOff);
     if (curFatsect != lastFatsect) {
       if (fp)
         brelse(fp);
@@ -386,35 +378,27 @@ fat_iupdate(struct inode *ip)
 struct inode*
 fat_iget(uint dev, uint inum, short type, uint dircluster)
 {
-  struct inode *ip, *empty;
-  struct fat_inode *fip, *tip;////////////
+  struct inode *ip;
+  struct fat_inode *tip;////////////
 
   acquire(&icache.lock);
 
   // Try for cached inode.
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    fip = vop_info(ip, fat_inode);
-//    cprintf("IGET: fstype = %d, ref = %d, dev = %d, inum = %d\n", ip->fstype, fip->ref, fip->dev, fip->inum);
-    if(ip->fstype == FAT_INODE && fip->ref > 0 && fip->dev == dev && fip->inum == inum){
-      fip->ref++;
-      release(&icache.lock);
-      return ip;
-    }
-    if(empty == 0 && fip->ref == 0)    // Remember empty slot.
-      empty = ip;
+  if((ip = icache_lookup(FAT_INODE, dev, inum)) != 0){
+    vop_info(ip, fat_inode)->ref++;
+    release(&icache.lock);
+    return ip;
   }
 
   // Allocate fresh inode.
-  if(empty == 0)
-    panic("iget: no inodes");
-
-  ip = empty;
+  ip = icache_alloc(FAT_INODE, dev, inum);
   tip = vop_info(ip, fat_inode);
   tip->dev = dev;
   tip->inum = inum;
   tip->ref = 1;
   tip->flags = 0;
+  tip->readers = 0;
+  tip->wwait = 0;
   tip->dircluster = dircluster;
   release(&icache.lock);
   // below added 12.27
@@ -451,8 +435,10 @@ fat_ilock(struct inode *ip)
   if(sin == 0 || sin->ref < 1)
     panic("ilock");
   acquire(&icache.lock);
-  while(sin->flags & I_BUSY)
+  sin->wwait++;
+  while((sin->flags & I_BUSY) || sin->readers > 0)
     sleep(ip, &icache.lock);//
+  sin->wwait--;
   sin->flags |= I_BUSY;
   release(&icache.lock);
   if (sin->inum == 2) { // Root file
@@ -466,15 +452,15 @@ fat_ilock(struct inode *ip)
     uint curFatsect, lastFatsect = 0, secOff;
     uint si, s, cno = sin->dircluster;
     struct buf *fp, *sp;
-    struct BPB bpb;
+    struct BPB *bpb;
     struct DIR *de;
   
-    fat_readbpb(sin->dev, &bpb);
+    bpb = &fat_getfs(sin->dev)->bpb;
     fp = 0;
     do {
-      s = fat_getFirstSectorofCluster(&bpb, cno);
- //     cprintf("secperclus = %d\n", bpb.SecPerClus);
-      for (si = 0; si < bpb.SecPerClus; ++si) { // Every sector
+      s = fat_getFirstSectorofCluster(bpb, cno);
+ //     cprintf("secperclus = %d\n", bpb->SecPerClus);
+      for (si = 0; si < bpb->SecPerClus; ++si) { // Every sector
  //       cprintf("secnum = %d\n", si);
   //      cprintf("before bread6 cursect = %d\n", s+si);
         sp = bread(sin->dev, s + si);
@@ -504,7 +490,7 @@ fat_ilock(struct inode *ip)
         brelse(sp);
       }
       // Find FAT entry
-      curFatsect = fat_getFATEntry(&bpb, cno, &secOff);
+      curFatsect = fat_getFATEntry(bpb, cno, &secOff);
       if (curFatsect != lastFatsect) {
         if (fp)
           brelse(fp);
@@ -520,17 +506,43 @@ fat_ilock(struct inode *ip)
   //panic("ilock DIR entry not found");
 }
 
-// Unlock the given inode.
+// Lock the given inode for reading, alongside other readers;
+// see sfs_ilock_shared.
+static void
+fat_ilock_shared(struct inode *ip)
+{
+  struct fat_inode *sin = vop_info(ip, fat_inode); 
+  if(sin == 0 || sin->ref < 1)
+    panic("ilock_shared");
+  acquire(&icache.lock);
+  if(!(sin->flags & I_VALID)){
+    release(&icache.lock);
+    fat_ilock(ip);
+    acquire(&icache.lock);
+    sin->flags &= ~I_BUSY;
+  } else {
+    while((sin->flags & I_BUSY) || sin->wwait > 0)
+      sleep(ip, &icache.lock);
+  }
+  sin->readers++;
+  wakeup(ip);
+  release(&icache.lock);
+}
+
+// Unlock the given inode, held either way.
 static void
 fat_iunlock(struct inode *ip)
 {
   struct fat_inode *sin = vop_info(ip, fat_inode); 
 //  cprintf("flags = %d, ref = %d\n", sin->flags, sin->ref);
-  if(sin == 0 || !(sin->flags & I_BUSY) || sin->ref < 1)
+  if(sin == 0 || (!(sin->flags & I_BUSY) && sin->readers < 1) || sin->ref < 1)
     panic("iunlock");
 
   acquire(&icache.lock);
-  sin->flags &= ~I_BUSY;
+  if(sin->flags & I_BUSY)
+    sin->flags &= ~I_BUSY;
+  else
+    sin->readers--;
   wakeup(ip);//
   release(&icache.lock);
 }
@@ -554,7 +566,8 @@ fat_iput(struct inode *ip)
     sin->flags = 0;
     wakeup(ip);//
   }
-  sin->ref--;
+  if(--sin->ref == 0)
+    icache_free(ip);
   release(&icache.lock);
 }
 
@@ -569,106 +582,147 @@ fat_iunlockput(struct inode *ip)
 
 // Inode contents
 
-// Truncate inode (discard contents).
-// Only called after the last dirent referring
-// to this inode has been erased on disk.
-static void
-fat_itrunc(struct inode *ip)
+// Where a short DIR entry is: cluster, sector in it, index in that.
+struct fat_dirpos {
+  uint cno;
+  uint si;
+  uint idx;
+};
+
+// Find the short entry for the file starting at cluster inum in the
+// directory starting at cluster dircluster. Returns -1 if there is none.
+static int
+fat_dirfind(uint dev, uint dircluster, uint inum, struct fat_dirpos *pos)
 {
-  struct fat_inode *sin = vop_info(ip, fat_inode); 
   uint curFatsect, lastFatsect = 0, secOff;
-  uint si, s, cno, chksum, cnoend, siend;
-  struct buf *fp, *sp, *fsip;
-  struct BPB bpb;
-  struct FSI *fsi;
-  struct DIR *de, *deend;
+  uint si, s, cno = dircluster;
+  struct buf *fp, *sp;
+  struct BPB *bpb;
+  struct DIR *de;
+  DIR_TYPE type;
 
-  fat_readbpb(sin->dev, &bpb);
+  bpb = &fat_getfs(dev)->bpb;
   fp = 0;
-  cno = sin->dircluster;
   do {
-    s = fat_getFirstSectorofCluster(&bpb, cno);
-    for (si = 0; si < bpb.SecPerClus; ++si) { // Every sector
- //     cprintf("before bread8 cursect = %d\n", s+si);
-      sp = bread(sin->dev, s + si);
+    s = fat_getFirstSectorofCluster(bpb, cno);
+    for (si = 0; si < bpb->SecPerClus; ++si) { // Every sector
+      sp = bread(dev, s + si);
       for (de = (struct DIR*)sp->data;
            de < (struct DIR*)(sp->data + SECTSIZE);
            ++de) {  // Every entry
-        if (((de->FstClusHI << 16) | de->FstClusLO) == sin->inum) {
-          chksum = fat_getChkSum(de->Name);
-          de->Name[0] = 0xE5;
-          bwrite(sp);
+        type = fat_getDIRType((struct LDIR*)de);
+        if (type != FAT_TYPE_LNAME && type != FAT_TYPE_EMPTY
+            && ((de->FstClusHI << 16) | de->FstClusLO) == inum) {
+          pos->cno = cno;
+          pos->si = si;
+          pos->idx = de - (struct DIR*)sp->data;
           brelse(sp);
           if (fp)
             brelse(fp);
-          cnoend = cno;
-          siend = si;
-          deend = de;
-          goto longname;
+          return 0;
         }
       }
       brelse(sp);
     }
     // Find FAT entry
-    curFatsect = fat_getFATEntry(&bpb, cno, &secOff);
+    curFatsect = fat_getFATEntry(bpb, cno, &secOff);
     if (curFatsect != lastFatsect) {
-      if (fp) {
-        bwrite(fp);
+      if (fp)
         brelse(fp);
-      }
-  //    cprintf("before bread9 cursect = %d\n", curFatsect);
-      fp = bread(sin->dev, curFatsect);
+      fp = bread(dev, curFatsect);
       lastFatsect = curFatsect;
     }
     cno = *(uint*)(fp->data + secOff);
   } while (!isEOF(cno));
-  panic("iupdate DIR entry not found");
+  brelse(fp);
+  return -1;
+}
+
+// Mark deleted the short entry at pos in the directory starting at
+// cluster dircluster, and the long name entries before it that
+// carry its check sum. Returns the number of entries deleted.
+static int
+fat_direrase(uint dev, uint dircluster, struct fat_dirpos *pos)
+{
+  uint curFatsect, lastFatsect = 0, secOff;
+  uint si, s, cno;
+  struct buf *fp, *sp;
+  struct BPB *bpb;
+  struct DIR *de;
+  uchar chksum;
+  int n;
+
+  bpb = &fat_getfs(dev)->bpb;
+  sp = bread(dev, fat_getFirstSectorofCluster(bpb, pos->cno) + pos->si);
+  de = (struct DIR*)sp->data + pos->idx;
+  chksum = fat_getChkSum(de->Name);
+  de->Name[0] = 0xE5;
+  bwrite(sp);
+  brelse(sp);
+  n = 1;
 
-longname:
   fp = 0;
-  cno = sin->dircluster;
+  cno = dircluster;
   do {
-    s = fat_getFirstSectorofCluster(&bpb, cno);
-    for (si = 0; si < bpb.SecPerClus; ++si) { // Every sector
-  //    cprintf("before bread10 cursect = %d\n", s+si);
-      sp = bread(sin->dev, s + si);
+    s = fat_getFirstSectorofCluster(bpb, cno);
+    for (si = 0; si < bpb->SecPerClus; ++si) { // Every sector
+      sp = bread(dev, s + si);
       for (de = (struct DIR*)sp->data;
            de < (struct DIR*)(sp->data + SECTSIZE);
            ++de) {  // Every entry
-        if (((struct LDIR*)de)->ChkSum == chksum) {
-          de->Name[0] = 0xE5;    
-        }
-        if(deend == de && siend == si && cnoend == cno){
+        if (cno == pos->cno && si == pos->si && de - (struct DIR*)sp->data == pos->idx) {
           bwrite(sp);
           brelse(sp);
           if (fp)
             brelse(fp);
-          goto fatentry;
+          return n;
+        }
+        if (fat_getDIRType((struct LDIR*)de) == FAT_TYPE_LNAME
+            && ((struct LDIR*)de)->ChkSum == chksum) {
+          de->Name[0] = 0xE5;
+          ++n;
         }
       }
+      bwrite(sp);
       brelse(sp);
     }
     // Find FAT entry
-    curFatsect = fat_getFATEntry(&bpb, cno, &secOff);
+    curFatsect = fat_getFATEntry(bpb, cno, &secOff);
     if (curFatsect != lastFatsect) {
       if (fp)
         brelse(fp);
-  //    cprintf("before bread11 cursect = %d\n", curFatsect);
-      fp = bread(sin->dev, curFatsect);
+      fp = bread(dev, curFatsect);
       lastFatsect = curFatsect;
     }
     cno = *(uint*)(fp->data + secOff);
   } while (!isEOF(cno));
-  if (fp)
-    brelse(fp);
+  panic("direrase");
+}
 
-fatentry:
-  fsip = bread(sin->dev, bpb.FSInfo);
+// Truncate inode (discard contents) and
+// erase the dirent referring to it.
+static void
+fat_itrunc(struct inode *ip)
+{
+  struct fat_inode *sin = vop_info(ip, fat_inode); 
+  uint curFatsect, lastFatsect = 0, secOff;
+  uint cno;
+  struct buf *fp, *fsip;
+  struct BPB *bpb;
+  struct FSI *fsi;
+  struct fat_dirpos pos;
+
+  bpb = &fat_getfs(sin->dev)->bpb;
+  if (fat_dirfind(sin->dev, sin->dircluster, sin->inum, &pos) < 0)
+    panic("itrunc DIR entry not found");
+  fat_direrase(sin->dev, sin->dircluster, &pos);
+
+  fsip = bread(sin->dev, bpb->FSInfo);
   fsi = (struct FSI*)fsip->data; 
   cno = sin->inum;
   fp = 0;
   do{
-    curFatsect = fat_getFATEntry(&bpb, cno, &secOff);
+    curFatsect = fat_getFATEntry(bpb, cno, &secOff);
     if (curFatsect != lastFatsect){
       if (fp) {
         fat_updateFATs(fp);
@@ -732,16 +786,16 @@ fat_readi(struct inode *ip, char *dst, uint off, uint n)
   uint clustersize;
 
   struct buf *fp, *sp;
-  struct BPB bpb;
+  struct BPB *bpb;
 
-  fat_readbpb(sin->dev, &bpb);
-  clustersize = bpb.SecPerClus * SECTSIZE;
+  bpb = &fat_getfs(sin->dev)->bpb;
+  clustersize = bpb->SecPerClus * SECTSIZE;
   fp = 0;
   do {
     // If it is in this cluster
     if (off < pos + clustersize) {
-      s = fat_getFirstSectorofCluster(&bpb, cno);
-      for (si = (off - pos) / SECTSIZE; si < bpb.SecPerClus; ++si) {
+      s = fat_getFirstSectorofCluster(bpb, cno);
+      for (si = (off - pos) / SECTSIZE; si < bpb->SecPerClus; ++si) {
    //     cprintf("before bread1, si = %d",si);
  //       cprintf("before bread13 cursect = %d\n", s+si);
         sp = bread(sin->dev, s + si);
@@ -757,7 +811,7 @@ fat_readi(struct inode *ip, char *dst, uint off, uint n)
     }
     pos += clustersize;
     // Find FAT entry
-    curFatsect = fat_getFATEntry(&bpb, cno, &secOff);
+    curFatsect = fat_getFATEntry(bpb, cno, &secOff);
     if (curFatsect != lastFatsect) {
       if (fp)
         brelse(fp);
@@ -775,6 +829,48 @@ finish:
   return n;
 }
 
+// Start reading the sectors holding bytes off to off+n of ip,
+// as far as the file goes, without waiting for them.
+static void
+fat_readahead(struct inode *ip, uint off, uint n)
+{
+  struct fat_inode *sin = vop_info(ip, fat_inode); 
+  uint curFatsect, lastFatsect = 0, secOff;
+  uint cno = sin->inum;
+  uint s, pos = 0, si, end;
+  uint clustersize;
+  struct buf *fp;
+  struct BPB *bpb;
+
+  if(sin->type != T_FILE || off >= sin->size)
+    return;
+  end = min(off + n, sin->size);
+  bpb = &fat_getfs(sin->dev)->bpb;
+  clustersize = bpb->SecPerClus * SECTSIZE;
+  fp = 0;
+  do {
+    if (off < pos + clustersize) {
+      s = fat_getFirstSectorofCluster(bpb, cno);
+      for (si = (off - pos) / SECTSIZE; si < bpb->SecPerClus && pos + si * SECTSIZE < end; ++si)
+        breadahead(sin->dev, s + si);
+      off = pos + clustersize;
+      if (off >= end)
+        break;
+    }
+    pos += clustersize;
+    curFatsect = fat_getFATEntry(bpb, cno, &secOff);
+    if (curFatsect != lastFatsect) {
+      if (fp)
+        brelse(fp);
+      fp = bread(sin->dev, curFatsect);
+      lastFatsect = curFatsect;
+    }
+    cno = *(uint*)(fp->data + secOff);
+  } while (!isEOF(cno));
+  if (fp)
+    brelse(fp);
+}
+
 // Write data to inode.
 int
 fat_writei(struct inode *ip, char *src, uint off, uint n)
@@ -796,17 +892,17 @@ fat_writei(struct inode *ip, char *src, uint off, uint n)
   uint clustersize;
 
   struct buf *fp, *sp;
-  struct BPB bpb;
+  struct BPB *bpb;
 
-  fat_readbpb(sin->dev, &bpb);
-  clustersize = bpb.SecPerClus * SECTSIZE;
+  bpb = &fat_getfs(sin->dev)->bpb;
+  clustersize = bpb->SecPerClus * SECTSIZE;
   fp = 0;
   do {
     // If it is in this cluster
     if (off < pos + clustersize) {
 //      cprintf("in if\n");
-      s = fat_getFirstSectorofCluster(&bpb, cno);
-      for (si = (off - pos) / SECTSIZE; si < bpb.SecPerClus; ++si) {
+      s = fat_getFirstSectorofCluster(bpb, cno);
+      for (si = (off - pos) / SECTSIZE; si < bpb->SecPerClus; ++si) {
 //        cprintf("in for\n");
 //        cprintf("before bread15 cursect = %d\n", s+si);
         sp = bread(sin->dev, s + si);
@@ -824,7 +920,7 @@ fat_writei(struct inode *ip, char *src, uint off, uint n)
 //    cprintf("enter fat_writei3\n");
     pos += clustersize;
     // Locate to FAT entry
-    curFatsect = fat_getFATEntry(&bpb, cno, &secOff);
+    curFatsect = fat_getFATEntry(bpb, cno, &secOff);
     if (curFatsect != lastFatsect) {
       if (fp) {
         fat_updateFATs(fp);
@@ -956,26 +1052,27 @@ fat_dirlookup(struct inode *dp, char *name, uint* poff)//modified 12.25
   if(fdp->type != T_DIR)
     panic("dirlookup not DIR");
   if(fdp->inum == 2 && strncmp(name, "..", 2) == 0){
-    return dp;
+    return fat_idup(dp);
   }
 //  cprintf("dpinum = %d\n", fdp->inum);
   uint curFatsect, lastFatsect = 0, secOff;
   uint cno = fdp->inum, si, s, inum;
   struct buf *fp, *sp = 0;
-  struct BPB bpb;
+  struct BPB *bpb;
   struct LDIR *de;
   char namebuf[FAT_DIRSIZ + 1]  = {0};
+  char shortname[13];
   uchar chksum = 0;
   int ord = 0;
   int nbp = 0, i;
   
-  fat_readbpb(fdp->dev, &bpb);
-//  cprintf("fat_dirlookup1, ExtFlags= %d, FilSysType = %s\n", bpb.ExtFlags, bpb.FilSysType);
+  bpb = &fat_getfs(fdp->dev)->bpb;
+//  cprintf("fat_dirlookup1, ExtFlags= %d, FilSysType = %s\n", bpb->ExtFlags, bpb->FilSysType);
   fp = 0;
   do {
-    s = fat_getFirstSectorofCluster(&bpb, cno);
+    s = fat_getFirstSectorofCluster(bpb, cno);
   //  cprintf("after get first sector cno = %d\n", cno);
-    for (si = 0; si < bpb.SecPerClus; ++si) {   // Every sector
+    for (si = 0; si < bpb->SecPerClus; ++si) {   // Every sector
   //    cprintf("before bread s + si = %d\n", s + si);
   //    cprintf("before bread17 cursect = %d\n", s+si);
       sp = bread(fdp->dev, s + si);
@@ -1012,9 +1109,11 @@ fat_dirlookup(struct inode *dp, char *name, uint* poff)//modified 12.25
 
           default:
     //        cprintf("name = %s, dename = %s\n", (char*)name, (char*)de);
+            copyshortname(shortname, (char*)de);
             if (!fat_namecmp(name, namebuf + nbp)           // Long file name
                     || !strncmp((char*)name, (char*)de, 11)       // Short name with no \0
-                    || !strncmp((char*)name, (char*)de, strlen(name))) {  // Short name with \0
+                    || !strncmp((char*)name, (char*)de, strlen(name))  // Short name with \0
+                    || !strncmp(name, shortname, sizeof(shortname))) {  // "NAME.EXT"
               // Matches
       //        cprintf("matches\n");
               inum = (((struct DIR*)de)->FstClusHI << 16) | ((struct DIR*)de)->FstClusLO;
@@ -1040,7 +1139,7 @@ fat_dirlookup(struct inode *dp, char *name, uint* poff)//modified 12.25
       brelse(sp);
     }
     // Find FAT entry
-    curFatsect = fat_getFATEntry(&bpb, cno, &secOff);
+    curFatsect = fat_getFATEntry(bpb, cno, &secOff);
     if (curFatsect != lastFatsect) {
       if (fp)
         brelse(fp);
@@ -1061,14 +1160,14 @@ fat_inumtoname(struct inode *dp, int inum, char* name){
   uint curFatsect, lastFatsect = 0, secOff;
   uint si, s;
   struct buf *fp, *sp;
-  struct BPB bpb;
+  struct BPB *bpb;
   struct DIR *de;
 //  cprintf("in inumtoname, inum = %d\n", fdp->inum);
-  fat_readbpb(fdp->dev, &bpb);
+  bpb = &fat_getfs(fdp->dev)->bpb;
   fp = 0;
   do {
-    s = fat_getFirstSectorofCluster(&bpb, cno);
-    for (si = 0; si < bpb.SecPerClus; ++si) { // Every sector
+    s = fat_getFirstSectorofCluster(bpb, cno);
+    for (si = 0; si < bpb->SecPerClus; ++si) { // Every sector
 //       cprintf("secnum = %d\n", si);
  //     cprintf("before bread s + si = %d\n", s + si);
       sp = bread(fdp->dev, s + si);
@@ -1089,7 +1188,7 @@ fat_inumtoname(struct inode *dp, int inum, char* name){
       brelse(sp);
     }
     // Find FAT entry
-    curFatsect = fat_getFATEntry(&bpb, cno, &secOff);
+    curFatsect = fat_getFATEntry(bpb, cno, &secOff);
     if (curFatsect != lastFatsect) {
       if (fp)
         brelse(fp);
@@ -1125,6 +1224,7 @@ fat_getpath(struct inode *node, char *path, int maxlen){
     vop_ref_dec(node);
 //    cprintf("after vop_ref_dec\n");
     if(node == parent){
+      vop_ref_dec(parent);
       vop_ref_dec(node);
       break;
     }
@@ -1250,19 +1350,19 @@ fat_dirlink(struct inode *dp, char *name, struct inode *ip)
   uint curFatsect, lastFatsect = 0, secOff;
   uint cno, si, s;
   struct buf *fp, *sp;
-  struct BPB bpb;
+  struct BPB *bpb;
   struct LDIR *de;
   int last, cnt;
   uint cno0 = 0, si0 = 0, de0 = 0;
 
   last = 0;
   cnt = 0;
-  fat_readbpb(fdp->dev, &bpb);
+  bpb = &fat_getfs(fdp->dev)->bpb;
   fp = 0;
   cno = fdp->inum;
   do {
-    s = fat_getFirstSectorofCluster(&bpb, cno);
-    for (si = 0; si < bpb.SecPerClus; ++si) {   // Every sector
+    s = fat_getFirstSectorofCluster(bpb, cno);
+    for (si = 0; si < bpb->SecPerClus; ++si) {   // Every sector
   //    cprintf("before bread21 cursect = %d\n", s+si);
       sp = bread(fdp->dev, s + si);
       for (de = (struct LDIR*)sp->data;
@@ -1308,7 +1408,7 @@ fat_dirlink(struct inode *dp, char *name, struct inode *ip)
       brelse(sp);
     }
     // Find FAT entry
-    curFatsect = fat_getFATEntry(&bpb, cno, &secOff);
+    curFatsect = fat_getFATEntry(bpb, cno, &secOff);
     if (curFatsect != lastFatsect) {
       if (fp) {
         fat_updateFATs(fp);
@@ -1329,8 +1429,8 @@ found:
   fp = 0;
   cno = cno0;
   do {
-    s = fat_getFirstSectorofCluster(&bpb, cno);
-    for (si = si0; si < bpb.SecPerClus; ++si) { // Every sector
+    s = fat_getFirstSectorofCluster(bpb, cno);
+    for (si = si0; si < bpb->SecPerClus; ++si) { // Every sector
   //    cprintf("before bread24 cursect = %d\n", s+si);
       sp = bread(fdp->dev, s + si);
       for (de = (struct LDIR*)(sp->data + de0), i = 0;
@@ -1352,7 +1452,7 @@ found:
       de0 = 0;
     }
     // Find FAT entry
-    curFatsect = fat_getFATEntry(&bpb, cno, &secOff);
+    curFatsect = fat_getFATEntry(bpb, cno, &secOff);
     if (curFatsect != lastFatsect) {
       if (fp)
         brelse(fp);
@@ -1366,115 +1466,6 @@ found:
   panic("dirlink");
 }
 
-// Paths.
-
-// Copy the next path element from path into name.
-// Return a pointer to the element following the copied one.
-// The returned path has no leading slashes,
-// so the caller can check *path=='\0' to see if the name is the last one.
-// If no name to remove, return 0.
-//
-// Examples:
-//   fat_skipelem("a/bb/c", name) = "bb/c", setting name = "a"
-//   fat_skipelem("///a//bb", name) = "bb", setting name = "a"
-//   fat_skipelem("a", name) = "", setting name = "a"
-//   fat_skipelem("", name) = skipelem("////", name) = 0
-//
-static char*
-fat_skipelem(char *path, char *name)
-{
-  char *s;
-  int len;
-
-  while(*path == '/')
-    path++;
-  if(*path == 0)
-    return 0;
-  s = path;
-  while(*path != '/' && *path != 0)
-    path++;
-  len = path - s;
-  if(len >= FAT_DIRSIZ)
-    memmove(name, s, FAT_DIRSIZ);
-  else {
-    memmove(name, s, len);
-    name[len] = 0;
-  }
-  while(*path == '/')
-    path++;
-  return path;
-}
-
-// Look up and return the inode for a path name.
-// If parent != 0, return the inode for the parent and copy the final
-// path element into name, which must have room for DIRSIZ bytes.
-static struct inode*
-fat_namex(struct inode *ip, char *path, int nameiparent, char *name)// modified 12.25
-{
-  struct inode *next;// modified 12.25
-  struct fat_inode *fip;// modified 12.25
-  
-  // if(*path == '/')
-  //   //ip = iget(ROOTDEV, 2, 0);
-  // //ip = iget(FAT_ROOTDEV, 2, 0);
-  // // to set FAT_ROOTDEV as 2..............................................
-  // ip = fat_iget(2, 2, 0);
-  // else
-  //   ip = fat_idup(proc->cwd);
-  
-  if (*path == '.'){
-    struct inode *cnode = proc->cwd;
-    struct fat_inode *fnode = vop_info(cnode, fat_inode);
-    if(fnode->inum == 2){
-      ++path;
-    }
-  }
-  // above: removed 12.25
-
-  while((path = fat_skipelem(path, name)) != 0){
-    fat_ilock(ip);
-    fip = vop_info(ip, fat_inode);
- //   cprintf("namex1: inum = %d\n", fip->inum);
-    if(fip->type != T_DIR){
-      fat_iunlockput(ip);
-      return 0;
-    }
-    if(nameiparent && *path == '\0'){
-      // Stop one level early.
-      fat_iunlock(ip);
-      return ip;
-    }
-    if((next = fat_dirlookup(ip, name, 0)) == 0){
-      fat_iunlockput(ip);
-      return 0;
-    }
-    fat_iunlockput(ip);
-    ip = next;
-  }
-  if(nameiparent){
-    fat_iput(ip);
- //   cprintf("namex4: inum = %d\n", fip->inum);
-    return 0;
-  }
- // cprintf("namex5: inum = %d\n", fip->inum);
-  return ip;
-}
-
-struct inode*
-fat_namei(struct inode *node, char *path)// modified 12.25
-{
-//  cprintf("enter fatnamei\n");
-  char name[FAT_DIRSIZ];
-  return fat_namex(node, path, 0, name);// modified 12.25
-}
-
-struct inode*
-fat_nameiparent(struct inode *node, char *path, char *name)// modified 12.25
-{
-  return fat_namex(node, path, 1, name);// modified 12.25
-}
-
-
 // functions added (begin)
 
 int
@@ -1493,6 +1484,123 @@ fat_isdirempty(struct inode *dp)
   return 1;
 }
 
+// Copy entries of directory dp, starting at byte offset *cookie,
+// into dst as struct dirents, as many as fit in n bytes. Long
+// names are put together from their LDIR entries. *cookie is
+// left at the first entry of the name that did not fit, or past
+// the end. Returns the number of bytes used, 0 at the end, or -1
+// if not one entry fits.
+static int
+fat_readdir(struct inode *dp, char *dst, uint n, uint *cookie)
+{
+  struct fat_inode *fdp = vop_info(dp, fat_inode);
+  uint curFatsect, lastFatsect = 0, secOff;
+  uint cno = fdp->inum, si, s, inum;
+  uint clustersize, pos, off, start, tot;
+  struct buf *fp, *sp;
+  struct BPB *bpb;
+  struct LDIR *de;
+  struct DIR *dir;
+  char namebuf[FAT_DIRSIZ + 1];
+  char *name;
+  uchar chksum = 0;
+  int ord = 0, lfn = 0;
+  int nbp = 0, i, r;
+
+  bpb = &fat_getfs(fdp->dev)->bpb;
+  clustersize = bpb->SecPerClus * SECTSIZE;
+  namebuf[FAT_DIRSIZ] = 0;
+  start = *cookie - *cookie % sizeof(*de);
+  tot = 0;
+  r = 1;
+  pos = 0;
+  fp = 0;
+  do {
+    if (start < pos + clustersize) {
+      s = fat_getFirstSectorofCluster(bpb, cno);
+      for (si = (start - pos) / SECTSIZE; si < bpb->SecPerClus; ++si) {   // Every sector
+        sp = bread(fdp->dev, s + si);
+        off = pos + si * SECTSIZE;
+        for (de = (struct LDIR*)sp->data;
+             de < (struct LDIR*)(sp->data + SECTSIZE);
+             ++de, off += sizeof(*de)) {          // Every entry
+          if (off < start)
+            continue;
+          switch (fat_getDIRType(de)) {
+
+            case FAT_TYPE_VOLLBL:
+            case FAT_TYPE_EMPTY:
+            case FAT_TYPE_ERROR:
+              lfn = 0;
+              start = off + sizeof(*de);
+              break;
+
+            case FAT_TYPE_LNAME:
+              if (de->Ord & FAT_TYPE_LLNMASK) {    // Last Entry
+                nbp = FAT_DIRSIZ;
+                chksum = de->ChkSum;
+                ord = de->Ord - FAT_TYPE_LLNMASK;
+                lfn = 1;
+                start = off;
+              } else if (chksum != de->ChkSum || --ord != de->Ord)
+                lfn = 0;
+              if (!lfn || nbp < 13) {
+                lfn = 0;
+                break;
+              }
+              for (i = 0; i < 2; ++i)
+                namebuf[nbp - 2 + i] = de->Name3[i] > 255 ? '_' : (char)de->Name3[i];
+              for (i = 0; i < 6; ++i)
+                namebuf[nbp - 8 + i] = de->Name2[i] > 255 ? '_' : (char)de->Name2[i];
+              for (i = 0; i < 5; ++i)
+                namebuf[nbp - 13 + i] = de->Name1[i] > 255 ? '_' : (char)de->Name1[i];
+              nbp -= 13;
+              break;
+
+            default:
+              dir = (struct DIR*)de;
+              if (lfn && ord == 1 && fat_getChkSum(dir->Name) == chksum)
+                name = namebuf + nbp;
+              else {
+                copyshortname(namebuf, (char*)dir->Name);
+                name = namebuf;
+              }
+              inum = (dir->FstClusHI << 16) | dir->FstClusLO;
+              if (!inum && !strncmp("..", (char*)dir->Name, 2))
+                inum = 2;
+              r = vfs_dirent(dst + tot, n - tot, inum, off + sizeof(*de),
+                             fat_mapAttr(dir->Attr), name, strlen(name));
+              if (r == 0) {
+                brelse(sp);
+                goto out;
+              }
+              tot += r;
+              lfn = 0;
+              start = off + sizeof(*de);
+          }
+        }
+        brelse(sp);
+      }
+    }
+    pos += clustersize;
+    // Find FAT entry
+    curFatsect = fat_getFATEntry(bpb, cno, &secOff);
+    if (curFatsect != lastFatsect) {
+      if (fp)
+        brelse(fp);
+      fp = bread(fdp->dev, curFatsect);
+      lastFatsect = curFatsect;
+    }
+    cno = *(uint*)(fp->data + secOff);
+  } while (!isEOF(cno));
+  start = pos;
+out:
+  if (fp)
+    brelse(fp);
+  *cookie = start;
+  return (tot == 0 && r == 0) ? -1 : tot;
+}
+
 // Increment reference count for ip.
 // Returns ip to enable ip = idup(ip1) idiom.
 struct inode*
@@ -1633,6 +1741,65 @@ bad:
   return -1;
 }
 
+// Move the entry oldname in directory olddp to newname in newdp, on
+// the same device. The file keeps its clusters; only its entries are
+// written. Directories are not moved.
+static int
+fat_rename(struct inode *olddp, char *oldname, struct inode *newdp, char *newname)
+{
+  struct fat_inode *fodp = vop_info(olddp, fat_inode);
+  struct fat_inode *fndp = vop_info(newdp, fat_inode);
+  struct fat_inode *fip;
+  struct fat_dirpos pos;
+  struct inode *ip;
+  int n;
+
+  if(fat_namecmp(oldname, ".") == 0 || fat_namecmp(oldname, "..") == 0)
+    return -1;
+  vop_ilock(olddp);
+  ip = fat_dirlookup(olddp, oldname, 0);
+  vop_iunlock(olddp);
+  if(ip == 0)
+    return -1;
+  fip = vop_info(ip, fat_inode);
+  vop_ilock(ip);
+  if(fip->type == T_DIR){
+    vop_iunlockput(ip);
+    return -1;
+  }
+  vop_iunlock(ip);
+
+  // Note where the old entry is before the new one, which
+  // has the same first cluster, can be put ahead of it.
+  vop_ilock(olddp);
+  if(fat_dirfind(fodp->dev, fodp->inum, fip->inum, &pos) < 0)
+    panic("rename: DIR entry not found");
+  vop_iunlock(olddp);
+
+  vop_ilock(newdp);
+  if(fat_dirlink(newdp, newname, ip) < 0){
+    vop_iunlock(newdp);
+    vop_ref_dec(ip);
+    return -1;
+  }
+  if(fndp->inum != 2)
+    vop_iupdate(newdp);
+  vop_iunlock(newdp);
+
+  vop_ilock(olddp);
+  n = fat_direrase(fodp->dev, fodp->inum, &pos);
+  fodp->size -= n * sizeof(struct DIR);
+  if(fodp->inum != 2)
+    vop_iupdate(olddp);
+  vop_iunlock(olddp);
+
+  vop_ilock(ip);
+  fip->dircluster = fndp->inum;
+  vop_iunlock(ip);
+  vop_ref_dec(ip);
+  return 0;
+}
+
 // functions added (end)
 
 
@@ -1645,12 +1812,11 @@ static const struct inode_ops fat_node_dirops = {
     .vop_iupdate                    = fat_iupdate,
     .vop_ref_inc                    = fat_idup,
     .vop_ref_dec                    = fat_iput,
-    .vop_namei                      = fat_namei,
-    .vop_nameiparent                = fat_nameiparent,
     .vop_dirlink                    = fat_dirlink,
     .vop_unlink                     = fat_unlink,
     .vop_dirlookup                  = fat_dirlookup,
     .vop_ilock                      = fat_ilock,
+    .vop_ilock_shared               = fat_ilock_shared,
     .vop_iunlock                    = fat_iunlock,
     .vop_iunlockput                 = fat_iunlockput,
     //.vop_ialloc                     = fat_ialloc,  //这个函数在fat32里没有用到。。。
@@ -1663,6 +1829,8 @@ static const struct inode_ops fat_node_dirops = {
     .vop_getdev                     = fat_getdev,
     .vop_getnlink                   = fat_getnlink,
     .vop_getpath                    = fat_getpath,
+    .vop_readdir                    = fat_readdir,
+    .vop_rename                     = fat_rename,
 }; 
 
 // The fatfs specific FILE operations correspond to the abstract operations on a inode.
@@ -1675,6 +1843,7 @@ static const struct inode_ops fat_node_fileops = {
     .vop_ref_inc                    = fat_idup,
     .vop_ref_dec                    = fat_iput,
     .vop_ilock                      = fat_ilock,
+    .vop_ilock_shared               = fat_ilock_shared,
     .vop_iunlock                    = fat_iunlock,
     .vop_iunlockput                 = fat_iunlockput,
     .vop_link_inc                   = fat_link_inc,
@@ -1686,4 +1855,5 @@ static const struct inode_ops fat_node_fileops = {
     .vop_getpath                    = fat_getpath,
     .vop_getmajor                   = sfs_getmajor,
     .vop_getminor                   = sfs_getminor,
+    .vop_readahead                  = fat_readahead,
 };
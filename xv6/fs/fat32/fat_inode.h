@@ -15,6 +15,8 @@ struct fat_inode {
   uint inum;          // Inode number
   int ref;            // Reference count
   int flags;          // I_BUSY, I_VALID
+  int readers;        // Holders of the shared lock
+  int wwait;          // ilock callers waiting for the readers
 
   short type;         // copy of disk inode
   short major;
@@ -5,21 +5,24 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "stat.h"
 #include "fs.h"
 #include "file.h"
 #include "spinlock.h"
 #include "inode.h"
+#include "fcntl.h"
 
 struct devsw devsw[NDEV];
 struct {
   struct spinlock lock;
-  struct file file[NFILE];
+  struct kcache *cache;
 } ftable;
 
 void
 fileinit(void)
 {
   initlock(&ftable.lock, "ftable");
+  ftable.cache = kcachecreate("file", sizeof(struct file), 0);
 }
 
 // Allocate a file structure.
@@ -28,16 +31,11 @@ filealloc(void)
 {
   struct file *f;
 
-  acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
-  }
-  release(&ftable.lock);
-  return 0;
+  if((f = kcachealloc(ftable.cache)) == 0)
+    return 0;
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -69,6 +67,7 @@ fileclose(struct file *f)
   f->ref = 0;
   f->type = FD_NONE;
   release(&ftable.lock);
+  kcachefree(ftable.cache, f);
   
   if(ff.type == FD_PIPE)
     pipeclose(ff.pipe, ff.writable);
@@ -84,7 +83,7 @@ int
 filestat(struct file *f, struct stat *st)
 {
   if(f->type == FD_INODE){
-    vop_ilock(f->ip);
+    vop_ilock_shared(f->ip);
     vop_fstat(f->ip, st);
     vop_iunlock(f->ip);
     return 0;
@@ -92,6 +91,19 @@ filestat(struct file *f, struct stat *st)
   return -1;
 }
 
+// Lock f's inode for a read that moves f->off. Readers can share
+// the inode unless they share f, when its offset needs the inode
+// lock to itself; a process holding the only reference to f
+// cannot be dup'ing it at the same time.
+static void
+filelockread(struct file *f)
+{
+  if(f->ref == 1)
+    vop_ilock_shared(f->ip);
+  else
+    vop_ilock(f->ip);
+}
+
 // Read from file f.
 int
 fileread(struct file *f, char *addr, int n)
@@ -104,7 +116,7 @@ fileread(struct file *f, char *addr, int n)
   if(f->type == FD_PIPE)
     return piperead(f->pipe, addr, n);
   if(f->type == FD_INODE){
-    vop_ilock(f->ip);
+    filelockread(f);
     if((r = vop_read(f->ip, addr, f->off, n)) > 0)
       f->off += r;
     vop_iunlock(f->ip);
@@ -113,45 +125,210 @@ fileread(struct file *f, char *addr, int n)
   panic("fileread");
 }
 
+// Read from file f into the cnt segments of iov in turn, under
+// one inode lock, stopping at the first short read. From a pipe,
+// only the first non-empty segment is read: another could block.
+int
+filereadv(struct file *f, struct iovec *iov, int cnt)
+{
+  int i, r, tot;
+
+  if(f->readable == 0)
+    return -1;
+  if(f->type == FD_PIPE){
+    for(i = 0; i < cnt && iov[i].iov_len == 0; i++)
+      ;
+    return i < cnt ? piperead(f->pipe, iov[i].iov_base, iov[i].iov_len) : 0;
+  }
+  if(f->type == FD_INODE){
+    tot = 0;
+    filelockread(f);
+    for(i = 0; i < cnt; i++){
+      if((r = vop_read(f->ip, iov[i].iov_base, f->off, iov[i].iov_len)) < 0){
+        if(tot == 0)
+          tot = -1;
+        break;
+      }
+      f->off += r;
+      tot += r;
+      if(r < iov[i].iov_len)
+        break;
+    }
+    vop_iunlock(f->ip);
+    return tot;
+  }
+  panic("filereadv");
+}
+
+// Read directory entries from file f, as struct dirents.
+// f->off is the directory's cookie for where to continue.
+int
+filegetdents(struct file *f, char *addr, int n)
+{
+  int r;
+  uint off;
+
+  if(f->type != FD_INODE || f->readable == 0)
+    return -1;
+  filelockread(f);
+  if(vop_gettype(f->ip) != T_DIR){
+    vop_iunlock(f->ip);
+    return -1;
+  }
+  off = f->off;
+  if((r = vop_readdir(f->ip, addr, n, &off)) >= 0)
+    f->off = off;
+  vop_iunlock(f->ip);
+  return r;
+}
+
+// Read from file f at offset off, leaving f->off alone.
+int
+filepread(struct file *f, char *addr, int n, uint off)
+{
+  int r;
+
+  if(f->readable == 0 || f->type != FD_INODE)
+    return -1;
+  vop_ilock_shared(f->ip);
+  r = vop_read(f->ip, addr, off, n);
+  vop_iunlock(f->ip);
+  return r;
+}
+
+// Set f->off from off and whence as lseek does, and return it.
+// Neither file system can hold a hole, so the offset must stay
+// within the file; a directory can only be rewound.
+int
+fileseek(struct file *f, int off, int whence)
+{
+  struct stat st;
+
+  if(f->type != FD_INODE)
+    return -1;
+  vop_ilock_shared(f->ip);
+  vop_fstat(f->ip, &st);
+  vop_iunlock(f->ip);
+  switch(whence){
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    off += f->off;
+    break;
+  case SEEK_END:
+    off += st.size;
+    break;
+  default:
+    return -1;
+  }
+  if(off < 0 || off > st.size || (st.type == T_DIR && off != 0))
+    return -1;
+  f->off = off;
+  return off;
+}
+
 //PAGEBREAK!
+// Write the cnt segments of iov in turn to the inode of f at *off,
+// advancing *off, or at the end of file if append is set.
+// Returns the number of bytes written, or -1 on error.
+static int
+writei(struct file *f, struct iovec *iov, int cnt, uint *off, int append)
+{
+  struct stat st;
+  int i, n1, r, room, done, tot;
+
+  // write a few blocks at a time to avoid exceeding
+  // the maximum log transaction size, including
+  // i-node, indirect block, allocation blocks,
+  // and 2 blocks of slop for non-aligned writes.
+  // this really belongs lower down, since writei()
+  // might be writing a device like the console.
+  // Segments share a transaction as long as they fit.
+  int max = ((LOGSIZE-1-1-2) / 2) * 512;
+  i = 0;
+  done = 0;
+  tot = 0;
+  r = 0;
+  while(i < cnt && r >= 0){
+    begin_trans();
+    vop_ilock(f->ip);
+    // Find the end under the same lock as the write, so
+    // that appending writers do not overwrite each other.
+    if(append){
+      vop_fstat(f->ip, &st);
+      *off = st.size;
+    }
+    for(room = max; room > 0 && i < cnt; ){
+      n1 = iov[i].iov_len - done;
+      if(n1 > room)
+        n1 = room;
+      if(n1 > 0){
+        if((r = vop_write(f->ip, (char*)iov[i].iov_base + done, *off, n1)) < 0)
+          break;
+        if(r != n1)
+          panic("short filewrite");
+        *off += r;
+        done += r;
+        tot += r;
+        room -= r;
+      }
+      if(done == iov[i].iov_len){
+        i++;
+        done = 0;
+      }
+    }
+    vop_iunlock(f->ip);
+    commit_trans();
+  }
+  return r < 0 ? -1 : tot;
+}
+
 // Write to file f.
 int
 filewrite(struct file *f, char *addr, int n)
 {
-  int r;
+  struct iovec iov;
 
   if(f->writable == 0)
     return -1;
   if(f->type == FD_PIPE)
     return pipewrite(f->pipe, addr, n);
   if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
-    // this really belongs lower down, since writei()
-    // might be writing a device like the console.
-    int max = ((LOGSIZE-1-1-2) / 2) * 512;
-    int i = 0;
-    while(i < n){
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
-
-      begin_trans();
-      vop_ilock(f->ip);
-      if ((r = vop_write(f->ip, addr + i, f->off, n1)) > 0)
-        f->off += r;
-      vop_iunlock(f->ip);
-      commit_trans();
-
-      if(r < 0)
-        break;
-      if(r != n1)
-        panic("short filewrite");
-      i += r;
-    }
-    return i == n ? n : -1;
+    iov.iov_base = addr;
+    iov.iov_len = n;
+    return writei(f, &iov, 1, &f->off, f->append);
   }
   panic("filewrite");
 }
+
+// Write the cnt segments of iov to file f, as one write.
+int
+filewritev(struct file *f, struct iovec *iov, int cnt)
+{
+  int i, r, tot;
+
+  if(f->writable == 0)
+    return -1;
+  if(f->type == FD_PIPE){
+    for(i = 0, tot = 0; i < cnt; i++, tot += r)
+      if((r = pipewrite(f->pipe, iov[i].iov_base, iov[i].iov_len)) < 0)
+        return -1;
+    return tot;
+  }
+  if(f->type == FD_INODE)
+    return writei(f, iov, cnt, &f->off, f->append);
+  panic("filewritev");
+}
+
+// Write to file f at offset off, leaving f->off alone.
+int
+filepwrite(struct file *f, char *addr, int n, uint off)
+{
+  struct iovec iov;
+
+  if(f->writable == 0 || f->type != FD_INODE)
+    return -1;
+  iov.iov_base = addr;
+  iov.iov_len = n;
+  return writei(f, &iov, 1, &off, 0);
+}
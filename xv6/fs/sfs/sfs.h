@@ -1 +1,33 @@
-struct inode *sfs_get_root();
\ No newline at end of file
+#ifndef __FS_SFS_SFS_H__
+#define __FS_SFS_SFS_H__
+
+#include "sfs_inode.h"
+#include "spinlock.h"
+
+// In-memory state of a mounted SFS volume.
+struct sfs_fs {
+  uint dev;
+  int valid;
+  struct sfs_super sb;
+  uint spb;          // sectors per block
+  struct spinlock lock;  // protects the maps and rotors
+  uchar **map;       // pages holding a copy of the on-disk free bitmap
+  uint nmap;         // pages in map
+  uint rotor;        // where to look for blocks with no goal
+  uint imap;         // where in map the inodes in use are, rebuilt
+                     // from the inode table
+  uint irotor;       // where to look for inodes with no directory
+};
+
+// Byte i of the free bitmap copy, and of the inode map. Their
+// pages come from kalloc one at a time, so they need not be
+// contiguous.
+#define FREEMAP(fs, i)  ((fs)->map[(i) / PGSIZE][(i) % PGSIZE])
+#define IMAP(fs, i)     FREEMAP(fs, (fs)->imap + (i))
+
+struct sfs_fs *sfs_getfs(uint dev);
+int sfs_mount(uint dev);
+void sfs_unmount(uint dev);
+struct inode *sfs_get_root(uint dev);
+
+#endif
@@ -3,14 +3,135 @@
 #include "param.h"
 #include "stat.h"
 #include "mmu.h"
+#include "buf.h"
 #include "sfs.h"
 #include "sfs_inode.h"
 #include "param.h"
 #include "inode.h"
 
+static struct sfs_fs sfs_fs[NSFS];
+
+// Pages needed for the free bitmap and inode map of sb.
+static uint
+sfs_mappages(struct sfs_super *sb)
+{
+	return ((sb->size + 7) / 8 + (sb->ninodes + 7) / 8 + PGSIZE - 1) / PGSIZE;
+}
+
+// Free the pages of the maps of fs, the first n of which
+// have been allocated.
+static void
+sfs_freemap(struct sfs_fs *fs, uint n)
+{
+	uint i;
+
+	for(i = 0; i < n; i++)
+		kfree((char*)fs->map[i]);
+	kfree((char*)fs->map);
+	fs->map = 0;
+}
+
+// Load the free bitmap of fs into memory and build a map of
+// the inodes in use, so that allocation doesn't have to scan
+// the disk. Both maps are spread over pages from kalloc,
+// listed in a page of their own, the inode map after the
+// free bitmap. sfs_mount has checked that one page can list
+// them all. Returns -1 if memory runs out.
+static int
+sfs_loadmap(struct sfs_fs *fs)
+{
+	struct buf *bp;
+	struct sfs_dinode *dip;
+	uint b, i, n, inum;
+
+	n = (fs->sb.size + 7) / 8;
+	fs->nmap = sfs_mappages(&fs->sb);
+	if((fs->map = (uchar**)kalloc()) == 0)
+		return -1;
+	for(i = 0; i < fs->nmap; i++){
+		if((fs->map[i] = (uchar*)kalloc()) == 0){
+			sfs_freemap(fs, i);
+			return -1;
+		}
+	}
+	// A bitmap sector never straddles two pages.
+	for(b = 0; b < fs->sb.size; b += SFSBPB){
+		bp = bread(fs->dev, BBLOCK(b, fs->sb.ninodes));
+		memmove(&FREEMAP(fs, b/8), bp->data,
+			n - b/8 < BSIZE ? n - b/8 : BSIZE);
+		brelse(bp);
+	}
+
+	fs->imap = n;
+	for(i = 0; i < (fs->sb.ninodes + 7) / 8; i++)
+		IMAP(fs, i) = 0;
+	IMAP(fs, 0) = 1;  // inode 0 is never used
+	for(inum = 1; inum < fs->sb.ninodes; inum++){
+		bp = bread(fs->dev, IBLOCK(inum));
+		dip = (struct sfs_dinode*)bp->data + inum%IPB;
+		if(dip->type != 0)
+			IMAP(fs, inum/8) |= 1 << (inum%8);
+		brelse(bp);
+	}
+	return 0;
+}
+
+// Return the state of the mounted SFS on device dev.
+struct sfs_fs *
+sfs_getfs(uint dev)
+{
+	struct sfs_fs *fs;
+
+	for(fs = sfs_fs; fs < &sfs_fs[NSFS]; fs++)
+		if(fs->valid && fs->dev == dev)
+			return fs;
+	panic("sfs_getfs: not mounted");
+}
+
+// Read the super block of device dev and build its allocation
+// maps. The root device is mounted by the first process, after
+// initlog has recovered the log, so the maps never hold a
+// half-installed transaction. Mounts are serialized by the VFS.
+int
+sfs_mount(uint dev)
+{
+	struct sfs_fs *fs;
+
+	for(fs = sfs_fs; fs < &sfs_fs[NSFS]; fs++)
+		if(!fs->valid)
+			break;
+	if(fs == &sfs_fs[NSFS])
+		return -1;
+	readsb(dev, &fs->sb);
+	if(fs->sb.bsize < BSIZE || fs->sb.bsize > MAXBSIZE ||
+	   fs->sb.bsize % BSIZE != 0 || fs->sb.ninodes == 0 ||
+	   fs->sb.nblocks >= fs->sb.size || fs->sb.nlog >= fs->sb.size ||
+	   sfs_mappages(&fs->sb) > PGSIZE / sizeof(uchar*))
+		return -1;
+	fs->dev = dev;
+	fs->spb = fs->sb.bsize / BSIZE;
+	initlock(&fs->lock, "sfs");
+	if(sfs_loadmap(fs) < 0)
+		return -1;
+	fs->rotor = 0;
+	fs->irotor = 1;
+	fs->valid = 1;
+	return 0;
+}
+
+void
+sfs_unmount(uint dev)
+{
+	struct sfs_fs *fs;
+
+	fs = sfs_getfs(dev);
+	sfs_freemap(fs, fs->nmap);
+	fs->valid = 0;
+}
+
 struct inode *
-sfs_get_root(){
+sfs_get_root(uint dev){
 	struct inode *node;
-	node = sfs_iget(ROOTDEV, ROOTINO, T_DIR);
+	node = sfs_iget(dev, ROOTINO, T_DIR);
 	return node;
-}
\ No newline at end of file
+}
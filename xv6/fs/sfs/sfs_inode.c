@@ -15,12 +15,12 @@
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 static void sfs_itrunc(struct inode*);
+static void dx_free(uint dev, uint b);
 static void sfs_ilock(struct inode *ip);
 static void sfs_iunlock(struct inode *ip);
 static const struct inode_ops sfs_node_dirops;
 static const struct inode_ops sfs_node_fileops;
 
-struct icache_universal icache;//added 12.27
 
 /*
  * sfs_get_ops - return function addr of fs_node_dirops/sfs_node_fileops
@@ -49,64 +49,101 @@ readsb(int dev, struct sfs_super *sb)
   brelse(bp);
 }
 
-// Zero a block.
+// Blocks. 
+//
+// Allocation works on the in-memory copy of the free bitmap in
+// struct sfs_fs; the on-disk bitmap is updated through the log
+// to match.
+
+// Set (used != 0) or clear the on-disk bits for blocks
+// b through b+n-1.
 static void
-bzero(int dev, int bno)
+bmark(struct sfs_fs *fs, uint b, uint n, int used)
 {
   struct buf *bp;
-  
-  bp = bread(dev, bno);
-  memset(bp->data, 0, BSIZE);
-  log_write(bp);
-  brelse(bp);
-}
+  uint bi, m;
 
-// Blocks. 
+  while(n > 0){
+    bp = bread(fs->dev, BBLOCK(b, fs->sb.ninodes));
+    do {
+      bi = b % SFSBPB;
+      m = 1 << (bi % 8);
+      if(used)
+        bp->data[bi/8] |= m;
+      else
+        bp->data[bi/8] &= ~m;
+      b++;
+      n--;
+    } while(n > 0 && b % SFSBPB != 0);
+    log_write(bp);
+    brelse(bp);
+  }
+}
 
-// Allocate a zeroed disk block.
+// Allocate up to n contiguous disk blocks, starting as close
+// after block goal as possible (goal 0 means no preference).
+// Returns the first block and sets *len to the number allocated.
+// Blocks are not cleared: writei zeroes the part of each sector
+// past the end of the file when it first writes there, and
+// extent tree nodes are initialized by their creator.
 static uint
-balloc(uint dev)
+balloc(uint dev, uint goal, uint n, uint *len)
 {
-  int b, bi, m;
-  struct buf *bp;
-  struct sfs_super sb;
-
-  bp = 0;
-  readsb(dev, &sb);
-  for(b = 0; b < sb.size; b += SFSBPB){
-    bp = bread(dev, BBLOCK(b, sb.ninodes));
-    for(bi = 0; bi < SFSBPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
-        brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
-      }
+  struct sfs_fs *fs;
+  uint b, e, nb, i;
+
+  fs = sfs_getfs(dev);
+  nb = fs->sb.size - fs->sb.nlog;  // don't hand out the log
+  acquire(&fs->lock);
+  if(goal == 0 || goal >= nb)
+    goal = fs->rotor;
+  b = goal;
+  for(i = 0; i < nb; i++, b++){
+    if(b >= nb)
+      b = 0;
+    if(b % 8 == 0 && b + 8 <= nb && i + 8 <= nb && FREEMAP(fs, b/8) == 0xFF){
+      i += 7;
+      b += 7;
+      continue;
     }
-    brelse(bp);
+    if((FREEMAP(fs, b/8) & (1 << (b%8))) == 0)
+      break;
   }
-  panic("balloc: out of blocks");
+  if(i == nb)
+    panic("balloc: out of blocks");
+  for(e = b; e < nb && e - b < n && (FREEMAP(fs, e/8) & (1 << (e%8))) == 0; e++)
+    FREEMAP(fs, e/8) |= 1 << (e%8);
+  fs->rotor = e;
+  release(&fs->lock);
+
+  bmark(fs, b, e - b, 1);
+  *len = e - b;
+  return b;
 }
 
-// Free a disk block.
+// Free disk blocks b through b+n-1.
 static void
-bfree(int dev, uint b)
+bfree(int dev, uint b, uint n)
 {
-  struct buf *bp;
-  struct sfs_super sb;
-  int bi, m;
-
-  readsb(dev, &sb);
-  bp = bread(dev, BBLOCK(b, sb.ninodes));
-  bi = b % SFSBPB;
-  m = 1 << (bi % 8);
-  if((bp->data[bi/8] & m) == 0)
-    panic("freeing free block");
-  bp->data[bi/8] &= ~m;
-  log_write(bp);
-  brelse(bp);
+  struct sfs_fs *fs;
+  uint i;
+
+  fs = sfs_getfs(dev);
+  acquire(&fs->lock);
+  for(i = b; i < b + n; i++){
+    if((FREEMAP(fs, i/8) & (1 << (i%8))) == 0)
+      panic("freeing free block");
+    FREEMAP(fs, i/8) &= ~(1 << (i%8));
+  }
+  release(&fs->lock);
+  bmark(fs, b, n, 0);
+}
+
+// First sector of block b.
+static uint
+bsect(uint dev, uint b)
+{
+  return b * sfs_getfs(dev)->spb;
 }
 
 // Inodes.
@@ -179,32 +216,67 @@ sfs_iinit(void)
 
 //PAGEBREAK!
 // Allocate a new inode with the given type on device dev.
-// A free inode has a type of zero.
+// A free inode has a type of zero; struct sfs_fs keeps a map
+// of which inodes are in use. The search starts at the
+// directory's own inode, so that a directory's children tend
+// to share inode sectors, or at a rotor when there is no
+// directory on this device.
 struct inode*
 sfs_ialloc(struct inode *dirnode, uint dev, short type)
 {
-  int inum;
+  uint inum, i, n;
   struct buf *bp;
   struct sfs_dinode *dip;
-  struct sfs_super sb;
-  struct inode *node;
-
-  readsb(dev, &sb);
-
-  for(inum = 1; inum < sb.ninodes; inum++){
-    bp = bread(dev, IBLOCK(inum));
-    dip = (struct sfs_dinode*)bp->data + inum%IPB;
-    if(dip->type == 0){  // a free inode
-      memset(dip, 0, sizeof(*dip));
-      dip->type = type;
-      log_write(bp);   // mark it allocated on the disk
-      brelse(bp);
-      node = sfs_iget(dev, inum, type);
-      return node;
+  struct sfs_fs *fs;
+
+  fs = sfs_getfs(dev);
+  n = fs->sb.ninodes;
+  acquire(&fs->lock);
+  inum = fs->irotor;
+  if(dirnode && dirnode->fstype == SFS_INODE &&
+     vop_info(dirnode, sfs_inode)->dev == dev)
+    inum = vop_info(dirnode, sfs_inode)->inum;
+  for(i = 0; i < n; i++, inum++){
+    if(inum >= n)
+      inum = 0;
+    if(inum % 8 == 0 && inum + 8 <= n && i + 8 <= n && IMAP(fs, inum/8) == 0xFF){
+      i += 7;
+      inum += 7;
+      continue;
     }
-    brelse(bp);
+    if((IMAP(fs, inum/8) & (1 << (inum%8))) == 0)
+      break;
   }
-  panic("ialloc: no inodes");
+  if(i == n)
+    panic("ialloc: no inodes");
+  IMAP(fs, inum/8) |= 1 << (inum%8);
+  fs->irotor = inum + 1;
+  release(&fs->lock);
+
+  bp = bread(dev, IBLOCK(inum));
+  dip = (struct sfs_dinode*)bp->data + inum%IPB;
+  if(dip->type != 0)
+    panic("ialloc: inode in use");
+  memset(dip, 0, sizeof(*dip));
+  dip->type = type;
+  log_write(bp);   // mark it allocated on the disk
+  brelse(bp);
+  return sfs_iget(dev, inum, type);
+}
+
+// Return inode inum on device dev to the in-memory map
+// once it has been marked free on disk.
+static void
+sfs_ifree(uint dev, uint inum)
+{
+  struct sfs_fs *fs;
+
+  fs = sfs_getfs(dev);
+  acquire(&fs->lock);
+  if((IMAP(fs, inum/8) & (1 << (inum%8))) == 0)
+    panic("freeing free inode");
+  IMAP(fs, inum/8) &= ~(1 << (inum%8));
+  release(&fs->lock);
 }
 
 // Copy a modified in-memory inode to disk.
@@ -222,7 +294,8 @@ sfs_iupdate(struct inode *ip)
   dip->minor = sin->minor;
   dip->nlink = sin->nlink;
   dip->size = sin->size;
-  memmove(dip->addrs, sin->addrs, sizeof(sin->addrs));
+  memmove(dip->extents, sin->extents, sizeof(sin->extents));
+  dip->exttree = sin->exttree;
   log_write(bp);
   brelse(bp);
 }
@@ -233,7 +306,7 @@ sfs_iupdate(struct inode *ip)
 struct inode*
 sfs_iget(uint dev, uint inum, short type)
 {
-  struct inode *ip, *empty;
+  struct inode *ip;
   struct sfs_inode *sip;
 //  struct buf *bp;
 //  struct sfs_dinode *dip;
@@ -241,29 +314,20 @@ sfs_iget(uint dev, uint inum, short type)
   acquire(&icache.lock);
 
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    sip = vop_info(ip, sfs_inode);
- //   cprintf("IGET: fstype = %d, ref = %d, dev = %d, inum = %d\n", ip->fstype, sip->ref, sip->dev, sip->inum);
-    if(ip->fstype == SFS_INODE && sip->ref > 0 && sip->dev == dev && sip->inum == inum){
-      sip->ref++;
-      release(&icache.lock);
-      return ip;
-    }
-    if(empty == 0 && sip->ref == 0)    // Remember empty slot.
-      empty = ip;
-  }
-  // Recycle an inode cache entry.
-  if(empty == 0)
-    panic("iget: no inodes");
-//  cprintf("inum1 = %d\n", inum);
-  ip = empty;
+  if((ip = icache_lookup(SFS_INODE, dev, inum)) != 0){
+    vop_info(ip, sfs_inode)->ref++;
+    release(&icache.lock);
+    return ip;
+  }
+  // Take a fresh inode cache entry.
+  ip = icache_alloc(SFS_INODE, dev, inum);
   sip = vop_info(ip, sfs_inode);
-//  cprintf("inum2 = %d\n", inum);
   sip->dev = dev;
   sip->inum = inum;
   sip->ref = 1;
   sip->flags = 0;
+  sip->readers = 0;
+  sip->wwait = 0;
   release(&icache.lock);
   if(type != 0){
     sip->type = type;
@@ -307,8 +371,10 @@ sfs_ilock(struct inode *ip)
     panic("ilock");
 
   acquire(&icache.lock);
-  while(sin->flags & I_BUSY)
+  sin->wwait++;
+  while((sin->flags & I_BUSY) || sin->readers > 0)
     sleep(ip, &icache.lock);
+  sin->wwait--;
   sin->flags |= I_BUSY;
   release(&icache.lock);
   
@@ -321,7 +387,8 @@ sfs_ilock(struct inode *ip)
     sin->minor = dip->minor;
     sin->nlink = dip->nlink;
     sin->size = dip->size;
-    memmove(sin->addrs, dip->addrs, sizeof(sin->addrs));
+    memmove(sin->extents, dip->extents, sizeof(sin->extents));
+    sin->exttree = dip->exttree;
     brelse(bp);
     sin->flags |= I_VALID;
     if(sin->type == 0)
@@ -329,16 +396,46 @@ sfs_ilock(struct inode *ip)
   }
 }
 
-// Unlock the given inode.
+// Lock the given inode for reading. Any number of readers
+// may hold it at once, but not along with ilock, and new
+// readers wait while an ilock caller does. The inode is read
+// from disk, if necessary, under the exclusive lock.
+static void
+sfs_ilock_shared(struct inode *ip)
+{
+  struct sfs_inode *sin = vop_info(ip, sfs_inode);
+
+  if(sin == 0 || sin->ref < 1)
+    panic("ilock_shared");
+
+  acquire(&icache.lock);
+  if(!(sin->flags & I_VALID)){
+    release(&icache.lock);
+    sfs_ilock(ip);
+    acquire(&icache.lock);
+    sin->flags &= ~I_BUSY;
+  } else {
+    while((sin->flags & I_BUSY) || sin->wwait > 0)
+      sleep(ip, &icache.lock);
+  }
+  sin->readers++;
+  wakeup(ip);
+  release(&icache.lock);
+}
+
+// Unlock the given inode, held either way.
 static void
 sfs_iunlock(struct inode *ip)
 {
   struct sfs_inode *sin = vop_info(ip, sfs_inode);
-  if(sin == 0 || !(sin->flags & I_BUSY) || sin->ref < 1)
+  if(sin == 0 || (!(sin->flags & I_BUSY) && sin->readers < 1) || sin->ref < 1)
     panic("iunlock");
 
   acquire(&icache.lock);
-  sin->flags &= ~I_BUSY;
+  if(sin->flags & I_BUSY)
+    sin->flags &= ~I_BUSY;
+  else
+    sin->readers--;
   wakeup(ip);
   release(&icache.lock);
 }
@@ -362,12 +459,14 @@ sfs_iput(struct inode *ip)
     sfs_itrunc(ip);
     sin->type = 0;
     sfs_iupdate(ip);
+    sfs_ifree(sin->dev, sin->inum);
     acquire(&icache.lock);
     sin->flags = 0;
     wakeup(ip);
   }
 //  cprintf("sin->inum = %d, sin->ref = %d\n", sin->inum, sin->ref);
-  sin->ref--;
+  if(--sin->ref == 0)
+    icache_free(ip);
 //  cprintf("sin->inum = %d, sin->ref = %d\n", sin->inum, sin->ref);
   release(&icache.lock);
 }
@@ -384,40 +483,296 @@ sfs_iunlockput(struct inode *ip)
 // Inode content
 //
 // The content (data) associated with each inode is stored
-// in blocks on the disk. The first NDIRECT block numbers
-// are listed in ip->addrs[].  The next NINDIRECT blocks are 
-// listed in block ip->addrs[NDIRECT].
+// in blocks on the disk, described by extents: each extent maps
+// len file blocks starting at file block start to the contiguous
+// disk blocks starting at addr. The first NEXTENT extents are
+// listed in ip->extents[]; later ones live in the extent tree
+// rooted at block ip->exttree.
+//
+// Files only ever grow by appending blocks (writei refuses to
+// write past the end), so a new block either extends the last
+// extent or starts a new one after it.
+
+// Find the extent covering file block bn in the tree rooted at
+// block root. Returns 0 if there is none.
+static int
+ext_lookup(uint dev, uint root, uint bn, struct sfs_extent *out)
+{
+  struct buf *bp;
+  struct sfs_extnode *node;
+  struct sfs_extent *e;
+  struct sfs_extidx *x;
+  int i;
+
+  bp = bread(dev, bsect(dev, root));
+  node = (struct sfs_extnode*)bp->data;
+  while(node->depth > 0){
+    x = (struct sfs_extidx*)(node + 1);
+    for(i = node->nentries - 1; i > 0 && x[i].start > bn; i--)
+      ;
+    root = x[i].addr;
+    brelse(bp);
+    bp = bread(dev, bsect(dev, root));
+    node = (struct sfs_extnode*)bp->data;
+  }
+  if(node->magic != EXTMAGIC)
+    panic("ext_lookup: bad node");
+  e = (struct sfs_extent*)(node + 1);
+  for(i = 0; i < node->nentries; i++){
+    if(bn >= e[i].start && bn < e[i].start + e[i].len){
+      *out = e[i];
+      brelse(bp);
+      return 1;
+    }
+  }
+  brelse(bp);
+  return 0;
+}
 
-// Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
+// Allocate a node of the given depth holding a path down to a
+// leaf that contains only extent e. Returns the node's block.
 static uint
-bmap(struct sfs_inode *ip, uint bn)
+ext_newpath(uint dev, int depth, struct sfs_extent *e)
 {
-  uint addr, *a;
   struct buf *bp;
+  struct sfs_extnode *node;
+  struct sfs_extidx *x;
+  uint b, child, len;
+
+  child = 0;
+  if(depth > 0)
+    child = ext_newpath(dev, depth - 1, e);
+  b = balloc(dev, 0, 1, &len);
+  bp = bread(dev, bsect(dev, b));
+  node = (struct sfs_extnode*)bp->data;
+  node->magic = EXTMAGIC;
+  node->depth = depth;
+  node->nentries = 1;
+  if(depth == 0){
+    *(struct sfs_extent*)(node + 1) = *e;
+  } else {
+    x = (struct sfs_extidx*)(node + 1);
+    x->start = e->start;
+    x->addr = child;
+  }
+  log_write(bp);
+  brelse(bp);
+  return b;
+}
 
-  if(bn < NDIRECT){
-    if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
-    return addr;
-  }
-  bn -= NDIRECT;
-
-  if(bn < NINDIRECT){
-    // Load indirect block, allocating if necessary.
-    if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
-    bp = bread(ip->dev, addr);
-    a = (uint*)bp->data;
-    if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
+// Append extent e to the subtree rooted at block b, merging it
+// into the last extent when the disk blocks are contiguous.
+// If the rightmost node on some level is full, a new sibling
+// is allocated for e; its block is returned so that the caller
+// can link it in. Otherwise returns 0.
+static uint
+ext_append(uint dev, uint b, struct sfs_extent *e)
+{
+  struct buf *bp;
+  struct sfs_extnode *node;
+  struct sfs_extent *last;
+  struct sfs_extidx *x;
+  uint sib, len;
+  int depth;
+
+  bp = bread(dev, bsect(dev, b));
+  node = (struct sfs_extnode*)bp->data;
+  if(node->magic != EXTMAGIC || node->nentries == 0)
+    panic("ext_append: bad node");
+  depth = node->depth;
+
+  if(depth == 0){
+    last = (struct sfs_extent*)(node + 1) + node->nentries - 1;
+    if(last->addr + last->len == e->addr){
+      last->len += e->len;
+      log_write(bp);
+      brelse(bp);
+      return 0;
+    }
+    if(node->nentries < NEXTLEAF){
+      last[1] = *e;
+      node->nentries++;
       log_write(bp);
+      brelse(bp);
+      return 0;
     }
     brelse(bp);
-    return addr;
+    return ext_newpath(dev, 0, e);
+  }
+
+  // Descend along the rightmost path without holding the buffer,
+  // so that deep trees don't pin one buffer per level.
+  x = (struct sfs_extidx*)(node + 1);
+  sib = x[node->nentries - 1].addr;
+  brelse(bp);
+  if((sib = ext_append(dev, sib, e)) == 0)
+    return 0;
+
+  bp = bread(dev, bsect(dev, b));
+  node = (struct sfs_extnode*)bp->data;
+  if(node->nentries < NEXTIDX){
+    x = (struct sfs_extidx*)(node + 1) + node->nentries;
+    x->start = e->start;
+    x->addr = sib;
+    node->nentries++;
+    log_write(bp);
+    brelse(bp);
+    return 0;
+  }
+  brelse(bp);
+
+  // This node is full too: start a new sibling above the one
+  // just created by the level below.
+  b = balloc(dev, 0, 1, &len);
+  bp = bread(dev, bsect(dev, b));
+  node = (struct sfs_extnode*)bp->data;
+  node->magic = EXTMAGIC;
+  node->depth = depth;
+  node->nentries = 1;
+  x = (struct sfs_extidx*)(node + 1);
+  x->start = e->start;
+  x->addr = sib;
+  log_write(bp);
+  brelse(bp);
+  return b;
+}
+
+// Record that file block e->start onwards now lives at e->addr.
+static void
+ext_add(struct sfs_inode *ip, struct sfs_extent *e)
+{
+  struct buf *bp;
+  struct sfs_extnode *node;
+  struct sfs_extidx *x;
+  struct sfs_extent *last;
+  uint sib, root, len;
+  int i;
+
+  if(ip->exttree == 0){
+    for(i = 0; i < NEXTENT && ip->extents[i].len; i++)
+      ;
+    last = i > 0 ? &ip->extents[i-1] : 0;
+    if(last && last->addr + last->len == e->addr){
+      last->len += e->len;
+      return;
+    }
+    if(i < NEXTENT){
+      ip->extents[i] = *e;
+      return;
+    }
+    ip->exttree = ext_newpath(ip->dev, 0, e);
+    return;
   }
 
-  panic("bmap: out of range");
+  if((sib = ext_append(ip->dev, ip->exttree, e)) == 0)
+    return;
+
+  // The root was full: grow the tree by one level.
+  bp = bread(ip->dev, bsect(ip->dev, ip->exttree));
+  node = (struct sfs_extnode*)bp->data;
+  i = node->depth + 1;
+  brelse(bp);
+  root = balloc(ip->dev, 0, 1, &len);
+  bp = bread(ip->dev, bsect(ip->dev, root));
+  node = (struct sfs_extnode*)bp->data;
+  node->magic = EXTMAGIC;
+  node->depth = i;
+  node->nentries = 2;
+  x = (struct sfs_extidx*)(node + 1);
+  last = &ip->extents[NEXTENT-1];
+  x[0].start = last->start + last->len;
+  x[0].addr = ip->exttree;
+  x[1].start = e->start;
+  x[1].addr = sib;
+  log_write(bp);
+  brelse(bp);
+  ip->exttree = root;
+}
+
+// Find the extent of inode ip covering file block bn.
+// Returns 0 if there is none.
+static int
+ext_find(struct sfs_inode *ip, uint bn, struct sfs_extent *out)
+{
+  struct sfs_extent *e;
+  int i;
+
+  for(i = 0; i < NEXTENT && ip->extents[i].len; i++){
+    e = &ip->extents[i];
+    if(bn >= e->start && bn < e->start + e->len){
+      *out = *e;
+      return 1;
+    }
+  }
+  return ip->exttree && ext_lookup(ip->dev, ip->exttree, bn, out);
+}
+
+// Return the disk block address of the nth block in inode ip,
+// and in *run the number of blocks from there on that are
+// contiguous on disk (at least 1).
+// If there is no such block, bmap allocates up to want blocks
+// for file blocks bn onwards, right after the file's previous
+// block if possible; this only happens for the block just past
+// the end of the file.
+static uint
+bmap(struct sfs_inode *ip, uint bn, uint want, uint *run)
+{
+  struct sfs_extent ext;
+  uint goal;
+
+  if(ext_find(ip, bn, &ext)){
+    *run = ext.start + ext.len - bn;
+    return ext.addr + bn - ext.start;
+  }
+
+  goal = 0;
+  if(bn > 0 && ext_find(ip, bn - 1, &ext))
+    goal = ext.addr + ext.len;
+  ext.start = bn;
+  ext.addr = balloc(ip->dev, goal, want, &ext.len);
+  ext_add(ip, &ext);
+  *run = ext.len;
+  return ext.addr;
+}
+
+// Free the blocks of extent e.
+static void
+ext_free(uint dev, struct sfs_extent *e)
+{
+  bfree(dev, e->addr, e->len);
+}
+
+// Free the extent tree rooted at block b and every block it maps.
+static void
+ext_freetree(uint dev, uint b)
+{
+  struct buf *bp;
+  struct sfs_extnode *node;
+  struct sfs_extent *e;
+  struct sfs_extidx *x;
+  uint i, n, child;
+
+  bp = bread(dev, bsect(dev, b));
+  node = (struct sfs_extnode*)bp->data;
+  n = node->nentries;
+  if(node->depth == 0){
+    e = (struct sfs_extent*)(node + 1);
+    for(i = 0; i < n; i++)
+      ext_free(dev, &e[i]);
+    brelse(bp);
+  } else {
+    // Release the buffer before descending; re-read it for
+    // each child so only one level is pinned at a time.
+    brelse(bp);
+    for(i = 0; i < n; i++){
+      bp = bread(dev, bsect(dev, b));
+      x = (struct sfs_extidx*)((struct sfs_extnode*)bp->data + 1);
+      child = x[i].addr;
+      brelse(bp);
+      ext_freetree(dev, child);
+    }
+  }
+  bfree(dev, b, 1);
 }
 
 // Truncate inode (discard contents).
@@ -429,27 +784,22 @@ static void
 sfs_itrunc(struct inode *ip)
 {
   struct sfs_inode *sin = vop_info(ip, sfs_inode);
-  int i, j;
-  struct buf *bp;
-  uint *a;
+  int i;
 
-  for(i = 0; i < NDIRECT; i++){
-    if(sin->addrs[i]){
-      bfree(sin->dev, sin->addrs[i]);
-      sin->addrs[i] = 0;
-    }
+  for(i = 0; i < NEXTENT; i++){
+    if(sin->extents[i].len)
+      ext_free(sin->dev, &sin->extents[i]);
   }
-  
-  if(sin->addrs[NDIRECT]){
-    bp = bread(sin->dev, sin->addrs[NDIRECT]);
-    a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
-      if(a[j])
-        bfree(sin->dev, a[j]);
-    }
-    brelse(bp);
-    bfree(sin->dev, sin->addrs[NDIRECT]);
-    sin->addrs[NDIRECT] = 0;
+  memset(sin->extents, 0, sizeof(sin->extents));
+
+  if(sin->exttree){
+    ext_freetree(sin->dev, sin->exttree);
+    sin->exttree = 0;
+  }
+
+  if(sin->type == T_DIR && sin->dirindex){
+    dx_free(sin->dev, sin->dirindex);
+    sin->dirindex = 0;
   }
 
   sin->size = 0;
@@ -476,7 +826,8 @@ sfs_readi(struct inode *ip, char *dst, uint off, uint n)
 {
 //  cprintf("enter sfs_readi\n");
   struct sfs_inode *sin = vop_info(ip, sfs_inode);
-  uint tot, m;
+  struct sfs_fs *fs;
+  uint tot, m, addr, run, bsize;
   struct buf *bp;
 //  cprintf("inum = %d , type = %d  \n", sin->inum, sin->type);
   if(sin->type == T_DEV){
@@ -490,22 +841,57 @@ sfs_readi(struct inode *ip, char *dst, uint off, uint n)
   if(off + n > sin->size)
     n = sin->size - off;
 
+  // Copy a sector at a time, stepping to the next block of the
+  // run returned by bmap at each block boundary.
+  fs = sfs_getfs(sin->dev);
+  bsize = fs->sb.bsize;
+  run = 0;
+  addr = 0;
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    bp = bread(sin->dev, bmap(sin, off/BSIZE));
+    if(run == 0)
+      addr = bmap(sin, off/bsize, 1, &run);
+    bp = bread(sin->dev, addr*fs->spb + off%bsize/BSIZE);
     m = min(n - tot, BSIZE - off%BSIZE);
     memmove(dst, bp->data + off%BSIZE, m);
     brelse(bp);
+    if((off + m) % bsize == 0){
+      addr++;
+      run--;
+    }
   }
   return n;
 }
 
+// Start reading the sectors holding bytes off to off+n of ip,
+// as far as the file goes, without waiting for them.
+static void
+sfs_readahead(struct inode *ip, uint off, uint n)
+{
+  struct sfs_inode *sin = vop_info(ip, sfs_inode);
+  struct sfs_fs *fs;
+  struct sfs_extent ext;
+  uint end, bsize;
+
+  if(sin->type != T_FILE || off >= sin->size)
+    return;
+  end = min(off + n, sin->size);
+  fs = sfs_getfs(sin->dev);
+  bsize = fs->sb.bsize;
+  for(off -= off%BSIZE; off < end; off += BSIZE){
+    if(!ext_find(sin, off/bsize, &ext))
+      break;
+    breadahead(sin->dev, (ext.addr + off/bsize - ext.start)*fs->spb + off%bsize/BSIZE);
+  }
+}
+
 // PAGEBREAK!
 // Write data to inode.
 int
 sfs_writei(struct inode *ip, char *src, uint off, uint n)
 {
   struct sfs_inode *sin = vop_info(ip, sfs_inode);
-  uint tot, m;
+  struct sfs_fs *fs;
+  uint tot, m, addr, run, bsize, fresh;
   struct buf *bp;
 
   if(sin->type == T_DEV){
@@ -519,12 +905,37 @@ sfs_writei(struct inode *ip, char *src, uint off, uint n)
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
+  fs = sfs_getfs(sin->dev);
+  bsize = fs->sb.bsize;
+  fresh = (sin->size + bsize - 1)/bsize;
+  run = 0;
+  addr = 0;
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(sin->dev, bmap(sin, off/BSIZE));
+    // Reserve blocks for the rest of the write in one go.
+    if(run == 0)
+      addr = bmap(sin, off/bsize, (off + n - tot - 1)/bsize - off/bsize + 1, &run);
+    bp = bread(sin->dev, addr*fs->spb + off%bsize/BSIZE);
     m = min(n - tot, BSIZE - off%BSIZE);
     memmove(bp->data + off%BSIZE, src, m);
-    log_write(bp);
+    // Blocks are not zeroed when allocated; clear whatever
+    // follows the new end of file in this sector.
+    if(off + m > sin->size && (off + m) % BSIZE != 0)
+      memset(bp->data + (off + m)%BSIZE, 0, BSIZE - (off + m)%BSIZE);
+    // Blocks past the old end of file are not reachable until
+    // the new size commits, so their data can go straight to
+    // disk ahead of the commit instead of through the log,
+    // unless the log holds the sector already (B_DIRTY). Only
+    // for files: no transaction writing file data frees blocks,
+    // so the block cannot belong to an uncommitted free.
+    if(sin->type == T_FILE && off/bsize >= fresh && !(bp->flags & B_DIRTY))
+      bwrite(bp);
+    else
+      log_write(bp);
     brelse(bp);
+    if((off + m) % bsize == 0){
+      addr++;
+      run--;
+    }
   }
 
   if(n > 0 && off > sin->size){
@@ -537,18 +948,288 @@ sfs_writei(struct inode *ip, char *src, uint off, uint n)
 //PAGEBREAK!
 // Directories
 
+// Hash of a directory entry name, over at most DIRSIZ
+// characters as namecmp compares them.
+static uint
+dirhash(char *name)
+{
+  uint h;
+  int i;
+
+  h = 2166136261U;
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = (h ^ (uchar)name[i]) * 16777619;
+  return h;
+}
+
+// The index nodes followed from the root towards a directory sector.
+struct dxpath {
+  int levels;
+  uint node[2];         // blocks, root first
+  int slot[2];          // entry followed in each
+};
+
+// Allocate an index node of the given depth holding entries
+// e[0..n-1], near block goal. Returns the node's block.
+static uint
+dx_newnode(uint dev, uint goal, int depth, struct sfs_hashidx *e, int n)
+{
+  struct buf *bp;
+  struct sfs_hashnode *node;
+  uint b, len;
+
+  b = balloc(dev, goal, 1, &len);
+  bp = bread(dev, bsect(dev, b));
+  memset(bp->data, 0, BSIZE);
+  node = (struct sfs_hashnode*)bp->data;
+  node->magic = HTMAGIC;
+  node->depth = depth;
+  node->nentries = n;
+  memmove(node + 1, e, n * sizeof(*e));
+  log_write(bp);
+  brelse(bp);
+  return b;
+}
+
+// Return the sector of hashed directory sdp that holds the names
+// with hash h. If path is not 0, record the nodes followed.
+static uint
+dx_find(struct sfs_inode *sdp, uint h, struct dxpath *path)
+{
+  struct buf *bp;
+  struct sfs_hashnode *node;
+  struct sfs_hashidx *e;
+  uint b, addr;
+  int lo, hi, mid, depth, level;
+
+  b = sdp->dirindex;
+  for(level = 0; ; level++){
+    bp = bread(sdp->dev, bsect(sdp->dev, b));
+    node = (struct sfs_hashnode*)bp->data;
+    e = (struct sfs_hashidx*)(node + 1);
+    if(node->magic != HTMAGIC || node->nentries == 0 || level >= 2)
+      panic("dx_find: bad index");
+    // Last entry with hash <= h; the first one covers 0.
+    lo = 0;
+    hi = node->nentries - 1;
+    while(lo < hi){
+      mid = (lo + hi + 1) / 2;
+      if(e[mid].hash <= h)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+    if(path){
+      path->node[level] = b;
+      path->slot[level] = lo;
+      path->levels = level + 1;
+    }
+    addr = e[lo].addr;
+    depth = node->depth;
+    brelse(bp);
+    if(depth == 0)
+      return addr;
+    b = addr;
+  }
+}
+
+// Insert entry (h, addr) after entry slot of index node b.
+// Returns -1 if the node is full.
+static int
+dx_insert(uint dev, uint b, int slot, uint h, uint addr)
+{
+  struct buf *bp;
+  struct sfs_hashnode *node;
+  struct sfs_hashidx *e;
+
+  bp = bread(dev, bsect(dev, b));
+  node = (struct sfs_hashnode*)bp->data;
+  e = (struct sfs_hashidx*)(node + 1);
+  if(node->nentries >= NHASHIDX){
+    brelse(bp);
+    return -1;
+  }
+  memmove(&e[slot + 2], &e[slot + 1], (node->nentries - slot - 1) * sizeof(*e));
+  e[slot + 1].hash = h;
+  e[slot + 1].addr = addr;
+  node->nentries++;
+  log_write(bp);
+  brelse(bp);
+  return 0;
+}
+
+// Add an index entry for directory sector addr, which takes over
+// the names with hash h and above from the sector covering h.
+// A full leaf node is split in two; if it is the root, its entries
+// first move down into a new node, giving the index a second level.
+// Returns -1, changing nothing, if the index is full.
+static int
+dx_add(struct inode *dp, uint h, uint addr)
+{
+  struct sfs_inode *sdp = vop_info(dp, sfs_inode);
+  struct dxpath path;
+  struct buf *bp, *lbp;
+  struct sfs_hashnode *node, *lnode;
+  struct sfs_hashidx *e, *le;
+  uint dev, leaf, sib;
+  int half, slot;
+
+  dev = sdp->dev;
+  dx_find(sdp, h, &path);
+  if(dx_insert(dev, path.node[path.levels-1], path.slot[path.levels-1], h, addr) == 0)
+    return 0;
+
+  bp = bread(dev, bsect(dev, sdp->dirindex));
+  node = (struct sfs_hashnode*)bp->data;
+  e = (struct sfs_hashidx*)(node + 1);
+  if(path.levels == 1){
+    leaf = dx_newnode(dev, sdp->dirindex, 0, e, node->nentries);
+    node->depth = 1;
+    node->nentries = 1;
+    e[0].hash = 0;
+    e[0].addr = leaf;
+    slot = 0;
+  } else {
+    if(node->nentries >= NHASHIDX){
+      brelse(bp);
+      return -1;
+    }
+    leaf = path.node[1];
+    slot = path.slot[0];
+  }
+
+  // Move the upper half of the leaf node into a sibling.
+  lbp = bread(dev, bsect(dev, leaf));
+  lnode = (struct sfs_hashnode*)lbp->data;
+  le = (struct sfs_hashidx*)(lnode + 1);
+  half = lnode->nentries / 2;
+  sib = dx_newnode(dev, leaf, 0, &le[half], lnode->nentries - half);
+  memmove(&e[slot + 2], &e[slot + 1], (node->nentries - slot - 1) * sizeof(*e));
+  e[slot + 1].hash = le[half].hash;
+  e[slot + 1].addr = sib;
+  node->nentries++;
+  lnode->nentries = half;
+  log_write(lbp);
+  brelse(lbp);
+  log_write(bp);
+  brelse(bp);
+
+  // There is room now.
+  return dx_add(dp, h, addr);
+}
+
+// Split sector s of hashed directory dp: the entries with the upper
+// half of its hashes move to a new sector at the end of the directory.
+// Returns -1 if they can't be split, because they all have the same
+// hash, or if the index is full.
+static int
+dx_split(struct inode *dp, uint s)
+{
+  struct sfs_inode *sdp = vop_info(dp, sfs_inode);
+  struct sfs_dirent de[NDIRENT];
+  uint hash[NDIRENT], h, m, t, moved;
+  int i, j, k, n, first;
+
+  if(sfs_readi(dp, (char*)de, s*BSIZE, BSIZE) != BSIZE)
+    panic("dx_split: read");
+  first = (s == 0) ? 2 : 0;  // "." and ".." stay put
+  n = 0;
+  for(i = first; i < NDIRENT; i++){
+    if(de[i].inum == 0)
+      continue;
+    h = dirhash(de[i].name);
+    for(j = n; j > 0 && hash[j-1] > h; j--)
+      hash[j] = hash[j-1];
+    hash[j] = h;
+    n++;
+  }
+  // Split at the median, keeping equal hashes on one side.
+  for(k = n/2; k > 0 && hash[k] == hash[k-1]; k--)
+    ;
+  if(k == 0){
+    for(k = n/2 + 1; k < n && hash[k] == hash[k-1]; k++)
+      ;
+    if(k >= n)
+      return -1;
+  }
+  m = hash[k];
+
+  t = sdp->size / BSIZE;
+  if(dx_add(dp, m, t) < 0)
+    return -1;
+  // Fill the new sector, then read the old one again
+  // to clear the entries that moved.
+  moved = 0;
+  k = 0;
+  for(i = first; i < NDIRENT; i++){
+    if(de[i].inum != 0 && dirhash(de[i].name) >= m){
+      moved |= 1U << i;
+      de[k++] = de[i];
+    }
+  }
+  memset(&de[k], 0, (NDIRENT - k) * sizeof(de[0]));
+  if(sfs_writei(dp, (char*)de, t*BSIZE, BSIZE) != BSIZE)
+    panic("dx_split: write");
+  if(sfs_readi(dp, (char*)de, s*BSIZE, BSIZE) != BSIZE)
+    panic("dx_split: read");
+  for(i = first; i < NDIRENT; i++)
+    if(moved & (1U << i))
+      memset(&de[i], 0, sizeof(de[i]));
+  if(sfs_writei(dp, (char*)de, s*BSIZE, BSIZE) != BSIZE)
+    panic("dx_split: write");
+  return 0;
+}
+
+// Free the hash index rooted at block b.
+static void
+dx_free(uint dev, uint b)
+{
+  struct buf *bp;
+  struct sfs_hashnode *node;
+  struct sfs_hashidx *e;
+  uint i;
+
+  bp = bread(dev, bsect(dev, b));
+  node = (struct sfs_hashnode*)bp->data;
+  e = (struct sfs_hashidx*)(node + 1);
+  if(node->depth > 0){
+    for(i = 0; i < node->nentries; i++)
+      bfree(dev, e[i].addr, 1);
+  }
+  brelse(bp);
+  bfree(dev, b, 1);
+}
+
+// Set [*start, *end) to the byte offsets in directory dp where
+// an entry named name can be.
+static void
+dirrange(struct sfs_inode *sdp, char *name, uint *start, uint *end)
+{
+  if(sdp->dirindex == 0){
+    *start = 0;
+    *end = sdp->size;
+  } else if(namecmp(name, ".") == 0 || namecmp(name, "..") == 0){
+    *start = 0;
+    *end = 2 * sizeof(struct sfs_dirent);
+  } else {
+    *start = dx_find(sdp, dirhash(name), 0) * BSIZE;
+    *end = *start + BSIZE;
+  }
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
 struct inode*
 sfs_dirlookup(struct inode *dp, char *name, uint *poff)
 {
-  uint off, inum;
+  uint off, inum, start, end;
   struct sfs_dirent de;
   struct sfs_inode *sdp = vop_info(dp, sfs_inode);
   if(sdp->type != T_DIR)
     panic("dirlookup not DIR");
 
-  for(off = 0; off < sdp->size; off += sizeof(de)){
+  dirrange(sdp, name, &start, &end);
+  for(off = start; off < end; off += sizeof(de)){
     if(sfs_readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
       panic("dirlink read");
 
@@ -636,8 +1317,9 @@ failed:
 int
 sfs_dirlink(struct inode *dp, char *name, struct inode *originip)
 {
-  int off;
+  uint off, start, end;
   struct sfs_dirent de;
+  struct sfs_hashidx all;
   struct inode *ip;
   struct sfs_inode *sin = vop_info(originip, sfs_inode);
   struct sfs_inode *sdp = vop_info(dp, sfs_inode);
@@ -648,12 +1330,31 @@ sfs_dirlink(struct inode *dp, char *name, struct inode *originip)
     return -1;
   }
 
-  // Look for an empty dirent.
-  for(off = 0; off < sdp->size; off += sizeof(de)){
-    if(sfs_readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
-      panic("dirlink read");
-    if(de.inum == 0)
+  for(;;){
+    // Look for an empty dirent where name belongs.
+    dirrange(sdp, name, &start, &end);
+    for(off = start; off < end; off += sizeof(de)){
+      if(sfs_readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
+        panic("dirlink read");
+      if(de.inum == 0)
+        break;
+    }
+    if(off < end)
+      break;
+    if(sdp->dirindex){
+      if(dx_split(dp, start / BSIZE) < 0)
+        return -1;
+    } else if(sdp->size == BSIZE){
+      // The first sector is full: index the directory,
+      // starting with that sector covering every hash.
+      all.hash = 0;
+      all.addr = 0;
+      sdp->dirindex = dx_newnode(sdp->dev, sdp->extents[0].addr, 0, &all, 1);
+      sfs_iupdate(dp);
+    } else {
+      // Append to a linear directory.
       break;
+    }
   }
 
   strncpy(de.name, name, DIRSIZ);
@@ -705,92 +1406,50 @@ sfs_unlink(struct inode *dp, char *name){
     return -1;
 }
 
-//PAGEBREAK!
-// Paths
-
-// Copy the next path element from path into name.
-// Return a pointer to the element following the copied one.
-// The returned path has no leading slashes,
-// so the caller can check *path=='\0' to see if the name is the last one.
-// If no name to remove, return 0.
-//
-// Examples:
-//   skipelem("a/bb/c", name) = "bb/c", setting name = "a"
-//   skipelem("///a//bb", name) = "bb", setting name = "a"
-//   skipelem("a", name) = "", setting name = "a"
-//   skipelem("", name) = skipelem("////", name) = 0
-//
-static char*
-skipelem(char *path, char *name)
+// Move the entry oldname in directory olddp to newname in newdp,
+// on the same device. The inode keeps its link count: one entry
+// is added and one cleared. Directories are not moved.
+static int
+sfs_rename(struct inode *olddp, char *oldname, struct inode *newdp, char *newname)
 {
-  char *s;
-  int len;
+  struct inode *ip, *tip;
+  struct sfs_dirent de;
+  uint off;
 
-  while(*path == '/')
-    path++;
-  if(*path == 0)
-    return 0;
-  s = path;
-  while(*path != '/' && *path != 0)
-    path++;
-  len = path - s;
-  if(len >= DIRSIZ)
-    memmove(name, s, DIRSIZ);
-  else {
-    memmove(name, s, len);
-    name[len] = 0;
-  }
-  while(*path == '/')
-    path++;
-  return path;
-}
-
-// Look up and return the inode for a path name.
-// If parent != 0, return the inode for the parent and copy the final
-// path element into name, which must have room for DIRSIZ bytes.
-static struct inode*
-namex(struct inode *ip, char *path, int nameiparent, char *name)
-{
-  struct inode *next;
-  struct sfs_inode *sinp;
-
-  while((path = skipelem(path, name)) != 0){
-    sfs_ilock(ip);
-    sinp = vop_info(ip, sfs_inode);
-    if(sinp->type != T_DIR){
-      sfs_iunlockput(ip);
-      return 0;
-    }
-    if(nameiparent && *path == '\0'){
-      // Stop one level early.
-      sfs_iunlock(ip);
-      return ip;
-    }
-    if((next = sfs_dirlookup(ip, name, 0)) == 0){
-      sfs_iunlockput(ip);
-      return 0;
-    }
-    sfs_iunlockput(ip);
-    ip = next;
-  }
-  if(nameiparent){
-    sfs_iput(ip);
-    return 0;
+  if(namecmp(oldname, ".") == 0 || namecmp(oldname, "..") == 0)
+    return -1;
+  vop_ilock(olddp);
+  ip = sfs_dirlookup(olddp, oldname, 0);
+  vop_iunlock(olddp);
+  if(ip == 0)
+    return -1;
+  vop_ilock(ip);
+  if(vop_gettype(ip) == T_DIR){
+    vop_iunlockput(ip);
+    return -1;
   }
-  return ip;
-}
+  vop_iunlock(ip);
 
-struct inode*
-sfs_namei(struct inode *node, char *path)
-{
-  char name[DIRSIZ];
-  return namex(node, path, 0, name);
-}
-
-struct inode*
-sfs_nameiparent(struct inode *node, char *path, char *name)
-{
-  return namex(node, path, 1, name);
+  vop_ilock(newdp);
+  if(sfs_dirlink(newdp, newname, ip) < 0){
+    vop_iunlock(newdp);
+    vop_ref_dec(ip);
+    return -1;
+  }
+  vop_iunlock(newdp);
+
+  // Look the old entry up again: adding the new one
+  // to the same hashed directory may have moved it.
+  vop_ilock(olddp);
+  if((tip = sfs_dirlookup(olddp, oldname, &off)) != ip)
+    panic("rename: entry gone");
+  vop_ref_dec(tip);
+  memset(&de, 0, sizeof(de));
+  if(sfs_writei(olddp, (char*)&de, off, sizeof(de)) != sizeof(de))
+    panic("rename: writei");
+  vop_iunlock(olddp);
+  vop_ref_dec(ip);
+  return 0;
 }
 
 // Is the directory dp empty except for "." and ".." ?
@@ -810,6 +1469,47 @@ sfs_isdirempty(struct inode *dp)
   return 1;
 }
 
+// Copy entries of directory dp, starting at byte offset *cookie,
+// into dst as struct dirents, as many as fit in n bytes.
+// Advances *cookie past the entries copied. Returns the number
+// of bytes used, 0 at the end, or -1 if not one entry fits.
+static int
+sfs_readdir(struct inode *dp, char *dst, uint n, uint *cookie)
+{
+  struct sfs_inode *sdp = vop_info(dp, sfs_inode);
+  struct sfs_dirent de[NDIRENT];
+  struct sfs_dinode *dip;
+  struct buf *bp;
+  uint off, tot, m;
+  short type;
+  int i, r, len;
+
+  tot = 0;
+  off = *cookie - *cookie % sizeof(de[0]);
+  while(off < sdp->size){
+    m = min(sdp->size - off, BSIZE - off % BSIZE);
+    if(sfs_readi(dp, (char*)de, off, m) != m)
+      panic("readdir: readi");
+    for(i = 0; i < m / sizeof(de[0]); i++, off += sizeof(de[0])){
+      if(de[i].inum == 0)
+        continue;
+      bp = bread(sdp->dev, IBLOCK(de[i].inum));
+      dip = (struct sfs_dinode*)bp->data + de[i].inum%IPB;
+      type = dip->type;
+      brelse(bp);
+      for(len = 0; len < DIRSIZ && de[i].name[len]; len++)
+        ;
+      r = vfs_dirent(dst + tot, n - tot, de[i].inum, off + sizeof(de[0]), type, de[i].name, len);
+      if(r == 0)
+        goto out;
+      tot += r;
+    }
+  }
+out:
+  *cookie = off;
+  return (tot == 0 && off < sdp->size) ? -1 : tot;
+}
+
 // Increment reference count for ip.
 // Returns ip to enable ip = idup(ip1) idiom.
 struct inode*
@@ -910,12 +1610,11 @@ static const struct inode_ops sfs_node_dirops = {
     .vop_iupdate                    = sfs_iupdate,
     .vop_ref_inc                    = sfs_idup,
     .vop_ref_dec                    = sfs_iput,
-    .vop_namei                      = sfs_namei,
-    .vop_nameiparent                = sfs_nameiparent,
     .vop_dirlink                    = sfs_dirlink,
     .vop_unlink                     = sfs_unlink,
     .vop_dirlookup                  = sfs_dirlookup,
     .vop_ilock                      = sfs_ilock,
+    .vop_ilock_shared               = sfs_ilock_shared,
     .vop_iunlock                    = sfs_iunlock,
     .vop_iunlockput                 = sfs_iunlockput,
     .vop_ialloc                     = sfs_ialloc,
@@ -928,6 +1627,8 @@ static const struct inode_ops sfs_node_dirops = {
     .vop_getdev                     = sfs_getdev,
     .vop_getnlink                   = sfs_getnlink,
     .vop_getpath                    = sfs_getpath,
+    .vop_readdir                    = sfs_readdir,
+    .vop_rename                     = sfs_rename,
 }; 
 // The sfs specific FILE operations correspond to the abstract operations on a inode.
 static const struct inode_ops sfs_node_fileops = {
@@ -939,6 +1640,7 @@ static const struct inode_ops sfs_node_fileops = {
     .vop_ref_inc                    = sfs_idup,
     .vop_ref_dec                    = sfs_iput,
     .vop_ilock                      = sfs_ilock,
+    .vop_ilock_shared               = sfs_ilock_shared,
     .vop_iunlock                    = sfs_iunlock,
     .vop_iunlockput                 = sfs_iunlockput,
     .vop_link_inc                   = sfs_link_inc,
@@ -949,4 +1651,5 @@ static const struct inode_ops sfs_node_fileops = {
     .vop_getnlink                   = sfs_getnlink,
     .vop_getmajor                   = sfs_getmajor,
     .vop_getminor                   = sfs_getminor,
+    .vop_readahead                  = sfs_readahead,
 };
@@ -5,60 +5,113 @@
 // On-disk file system format. 
 // Both the kernel and user programs use this header file.
 
-// Block 0 is unused.
-// Block 1 is super block.
-// Blocks 2 through sb.ninodes/IPB hold inodes.
-// Then free bitmap blocks holding sb.size bits.
-// Then sb.nblocks data blocks.
-// Then sb.nlog log blocks.
+// File data is allocated in blocks of sb.bsize bytes, a multiple
+// of the BSIZE-byte disk sector. Metadata is addressed by sector:
+// Sector 0 is unused.
+// Sector 1 is super block.
+// Sectors 2 through sb.ninodes/IPB hold inodes.
+// Then free bitmap sectors holding sb.size bits, one per block.
+// The data blocks start at the first block boundary after the
+// bitmap; sb.nblocks of them are followed by sb.nlog log blocks.
 
 #define ROOTINO 1  // root i-number
-#define BSIZE 512  // block size
-
-#define NDIRECT 12
-#define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define BSIZE 512  // sector size
+#define MAXBSIZE 4096  // largest block size
+// A file's blocks are described by extents, runs of contiguous disk
+// blocks. The first NEXTENT extents live in the inode itself; once
+// they are used up, further extents go into an extent tree whose
+// root block is recorded in exttree.
+#define NEXTENT 4
+#define MAXFILE (0xFFFFFFFF / BSIZE)  // max file size (sectors)
 
 struct sfs_super{
   uint size;         // Size of file system image (blocks)
   uint nblocks;      // Number of data blocks
   uint ninodes;      // Number of inodes.
   uint nlog;         // Number of log blocks
+  uint bsize;        // Block size (bytes)
+};
+
+struct sfs_extent{
+  uint start;           // First file block covered by the extent
+  uint addr;            // First disk block of the extent
+  uint len;             // Number of blocks (0 if the slot is unused)
 };
 
 struct sfs_dinode{
   short type;           // File type
-  short major;          // Major device number (T_DEV only)
-  short minor;          // Minor device number (T_DEV only)
+  union {
+    struct {
+      short major;      // Major device number (T_DEV only)
+      short minor;      // Minor device number (T_DEV only)
+    };
+    uint dirindex;      // Block of the hash index root (T_DIR only, 0 if none)
+  } __attribute__((packed));
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
-  uint addrs[NDIRECT+1];   // Data block addresses
+  struct sfs_extent extents[NEXTENT];   // Inline extents
+  uint exttree;         // Root block of the extent tree (0 if none)
+};
+
+// Extent tree node. A node fills the first sector of a block: the
+// header is followed by nentries sfs_extent entries in a leaf
+// (depth 0) or sfs_extidx entries in an index node (depth > 0),
+// sorted by start. Files only
+// grow at their end, so the tree is appended to along its rightmost
+// path and never needs to be rebalanced.
+// The rest of the block is unused when sb.bsize > BSIZE: the buffer
+// cache and the log work in sectors, and a node spanning a block
+// would cost sb.bsize/BSIZE log slots for every entry added. A leaf
+// holds 42 extents and an index node 63 children, so two levels
+// already cover 2646 extents.
+#define EXTMAGIC 0xE47E
+
+struct sfs_extnode{
+  ushort magic;         // EXTMAGIC
+  ushort depth;         // 0 for a leaf
+  uint nentries;        // Number of entries in use
+};
+
+struct sfs_extidx{
+  uint start;           // First file block covered by the child
+  uint addr;            // Block holding the child node
 };
 
+#define NEXTLEAF ((BSIZE - sizeof(struct sfs_extnode)) / sizeof(struct sfs_extent))
+#define NEXTIDX  ((BSIZE - sizeof(struct sfs_extnode)) / sizeof(struct sfs_extidx))
+
 struct sfs_inode{
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
   int flags;          // I_BUSY, I_VALID
+  int readers;        // Holders of the shared lock
+  int wwait;          // ilock callers waiting for the readers
 
   short type;         // copy of disk inode
-  short major;
-  short minor;
+  union {
+    struct {
+      short major;
+      short minor;
+    };
+    uint dirindex;
+  } __attribute__((packed));
   short nlink;
   uint size;
-  uint addrs[NDIRECT+1];
+  struct sfs_extent extents[NEXTENT];
+  uint exttree;
 };
 
-// Inodes per block.
+// Inodes per sector.
 #define IPB           (BSIZE / sizeof(struct sfs_dinode))
 
-// Block containing inode i
+// Sector containing inode i
 #define IBLOCK(i)     ((i) / IPB + 2)
 
-// Bitmap bits per block
+// Bitmap bits per sector
 #define SFSBPB           (BSIZE*8)
 
-// Block containing bit for block b
+// Sector containing bit for block b
 #define BBLOCK(b, ninodes) (b/SFSBPB + (ninodes)/IPB + 3)
 
 // Directory is a file containing a sequence of dirent structures.
@@ -69,6 +122,34 @@ struct sfs_dirent {
   char name[DIRSIZ];
 };
 
+// Directory entries per sector.
+#define NDIRENT (BSIZE / sizeof(struct sfs_dirent))
+
+// A directory that outgrows its first sector gets a hash index.
+// Each sector of the directory then holds the entries whose name
+// hashes fall in one range, except that "." and ".." always stay
+// in the first two slots. The index is a tree of at most two
+// levels, each node filling the first sector of a block as extent
+// tree nodes do: the header is followed by nentries sfs_hashidx
+// entries sorted by hash, the first of which covers hash 0.
+// Entries of a leaf node (depth 0) give directory sectors, those
+// of the root at depth 1 give leaf nodes. Programs that read a directory as an array of
+// sfs_dirents see it unchanged, with some empty slots.
+#define HTMAGIC 0x4854
+
+struct sfs_hashnode{
+  ushort magic;         // HTMAGIC
+  ushort depth;         // 0 for a leaf
+  uint nentries;        // Number of entries in use
+};
+
+struct sfs_hashidx{
+  uint hash;            // Lowest name hash covered by the entry
+  uint addr;            // Directory sector, or block of a leaf node
+};
+
+#define NHASHIDX ((BSIZE - sizeof(struct sfs_hashnode)) / sizeof(struct sfs_hashidx))
+
 struct inode* sfs_iget(uint dev, uint inum, short type);
 
 
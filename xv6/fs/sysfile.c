@@ -73,11 +73,81 @@ sys_read(void)
   int n;
   char *p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argwptr(1, &p, n) < 0)
     return -1;
   return fileread(f, p, n);
 }
 
+int
+sys_getdents(void)
+{
+  struct file *f;
+  int n;
+  char *p;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argwptr(1, &p, n) < 0)
+    return -1;
+  return filegetdents(f, p, n);
+}
+
+// Fetch the nth system call argument as an array of cnt iovecs
+// into iov, checking that each segment lies in the process and,
+// if write is set, that the kernel may store into it.
+static int
+argiov(int n, int cnt, struct iovec *iov, int write)
+{
+  char *p;
+  int i;
+
+  if(cnt < 0 || cnt > IOV_MAX || argptr(n, &p, cnt*sizeof(struct iovec)) < 0)
+    return -1;
+  memmove(iov, p, cnt*sizeof(struct iovec));
+  for(i = 0; i < cnt; i++){
+    if(iov[i].iov_len == 0)
+      continue;
+    if(uvmaccess((uint)iov[i].iov_base, iov[i].iov_len, write) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+int
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int cnt;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &cnt) < 0 || argiov(1, cnt, iov, 1) < 0)
+    return -1;
+  return filereadv(f, iov, cnt);
+}
+
+int
+sys_pread(void)
+{
+  struct file *f;
+  int n, off;
+  char *p;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argwptr(1, &p, n) < 0 || argint(3, &off) < 0)
+    return -1;
+  if(off < 0)
+    return -1;
+  return filepread(f, p, n, off);
+}
+
+int
+sys_lseek(void)
+{
+  struct file *f;
+  int off, whence;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &off) < 0 || argint(2, &whence) < 0)
+    return -1;
+  return fileseek(f, off, whence);
+}
+
 int
 sys_write(void)
 {
@@ -90,6 +160,32 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+int
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int cnt;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &cnt) < 0 || argiov(1, cnt, iov, 0) < 0)
+    return -1;
+  return filewritev(f, iov, cnt);
+}
+
+int
+sys_pwrite(void)
+{
+  struct file *f;
+  int n, off;
+  char *p;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0 || argint(3, &off) < 0)
+    return -1;
+  if(off < 0)
+    return -1;
+  return filepwrite(f, p, n, off);
+}
+
 int
 sys_close(void)
 {
@@ -109,7 +205,7 @@ sys_fstat(void)
   struct file *f;
   struct stat *st;
   
-  if(argfd(0, 0, &f) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+  if(argfd(0, 0, &f) < 0 || argwptr(1, (void*)&st, sizeof(*st)) < 0)
     return -1;
   return filestat(f, st);
 }
@@ -259,6 +355,7 @@ sys_open(void)
   f->off = 0;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+  f->append = (omode & O_APPEND) != 0;
   
   return fd;
 }
@@ -352,7 +449,7 @@ sys_pipe(void)
   struct file *rf, *wf;
   int fd0, fd1;
 
-  if(argptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
+  if(argwptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
     return -1;
   if(pipealloc(&rf, &wf) < 0)
     return -1;
@@ -374,15 +471,48 @@ sys_getcwd(void)
 {
   char* buf;
   int len;
-  if(argstr(0, &buf) < 0 || argint(1, &len) < 0){
-    return -1;
-  }
-  if(len == 0){
+  if(argint(1, &len) < 0 || len <= 0 || argwptr(0, &buf, len) < 0){
     return -1;
   }
   return vfs_getcwd(buf, len);
 }
 
+// Copy path into buf, which has room for n bytes, so that the
+// names taken apart below stay as the process passed them.
+static char*
+pathcopy(char *buf, char *path, int n)
+{
+  if(strlen(path) >= n)
+    return 0;
+  return safestrcpy(buf, path, n);
+}
+
+// Copy the contents of src to file dstpath, creating it if
+// need be. Returns 0 if all of src was copied.
+static int
+copyfile(struct inode *src, char *dstpath)
+{
+  struct inode *dst;
+  struct stat st;
+  int r;
+
+  vop_ilock(src);
+  vop_fstat(src, &st);
+  vop_iunlock(src);
+  begin_trans();
+  dst = create(dstpath, T_FILE, vop_getmajor(src), vop_getminor(src));
+  if(dst != 0)
+    vop_iunlock(dst);
+  commit_trans();
+  if(dst == 0)
+    return -1;
+  r = vfs_copy_range(src, 0, dst, 0, st.size);
+  begin_trans();
+  vop_ref_dec(dst);
+  commit_trans();
+  return r == st.size ? 0 : -1;
+}
+
 int
 sys_copy(void)
 {
@@ -393,91 +523,56 @@ sys_copy(void)
   a.txtƵĿ¼a.txt  
   */
 
-  begin_trans();
- 
-  char *srcpath, *destpath, temppath[100];// destparentname[260];
-  struct inode *srcnode, *destnode;// *destptnode;
-  memset(temppath, 0, 100);
-//  cprintf("enter sys_copy1\n");
+  char *srcpath, *destpath, *name, path[128];
+  struct inode *srcnode, *destnode;
+  int r, n, intodir;
+
   if(argstr(0, &srcpath) < 0 || argstr(1, &destpath) < 0)
   {
     cprintf("cp: path error!\n");
-    commit_trans();
     return -1;
   }
-///  cprintf("enter sys_copy2 src=%s, dest=%s\n",srcpath, destpath);
-  if((srcnode = vfs_lookup(srcpath)) == 0)
+  if(pathcopy(path, srcpath, sizeof(path)) == 0 || (srcnode = vfs_lookup(path)) == 0)
   {
     cprintf("cp: source file does not exits!\n");
-    commit_trans();
     return -1;
   }
-// cprintf("enter sys_copy3\n");
+  vop_ilock(srcnode);
   if(vop_gettype(srcnode) != T_FILE)
   {
     cprintf("cp: source path is not a file!\n");
-    commit_trans();
+    vop_iunlockput(srcnode);
     return -1;
   }
-// cprintf("enter sys_copy4\n");
-  strncpy((char*)temppath, destpath, strlen(destpath));
-  
-  if((destnode = vfs_lookup(temppath)) && vop_gettype(destnode) == T_DIR)
-  {
-  //  vop_iunlockput(destptnode);
-    cprintf("dest is directory\n");
-    char* srcfilename = &srcpath[strlen(srcpath)-1];
-    while(*srcfilename != '/' && srcfilename != srcpath){
-      srcfilename--;    
-    }
-    char* destfullpath = &destpath[strlen(destpath)];
-    if(*srcfilename != '/')
-    {
-      *destfullpath = '/';
-      destfullpath++;
-    }   
-    while(*srcfilename != 0)
-    {
-      *destfullpath = *srcfilename;
-      destfullpath++;
-      srcfilename++;
-    }
-    *destfullpath = 0;
-    cprintf("end of dest is destpath = %s\n", destpath);
-  }
-  else
-  {
-   // cprintf("enter sys_copy5 destpath = %s\n", destpath);
-    // if((destptnode = vfs_lookup_parent(destpath, destparentname)) == 0)
-    // {
-    //   cprintf("cp: dest path error!\n");
-    //   commit_trans();
-    //   return -1;
-    // } 
-  }
-  if((destnode = create(destpath, T_FILE, vop_getmajor(srcnode), vop_getminor(srcnode))) == 0)
-  {
-    cprintf("cp: can not create destination's inode!\n");
-    commit_trans();
-    return -1;
+  vop_iunlock(srcnode);
+
+  // Copying to a directory keeps the name.
+  intodir = 0;
+  if(pathcopy(path, destpath, sizeof(path)) != 0 && (destnode = vfs_lookup(path)) != 0){
+    vop_ilock(destnode);
+    intodir = vop_gettype(destnode) == T_DIR;
+    vop_iunlockput(destnode);
   }
- // cprintf("enter sys_copy6\n");
-  vop_iunlockput(destnode);
-  vop_ilock(srcnode);
-  int offset = 0, count;
-  char buf[512];  
-//  cprintf("srctype = %d, desttype = %d\n", srcnode->fstype, destnode->fstype);
-  while((count = vop_read(srcnode, buf, offset, 512)) > 0)
-  {
-  //  cprintf("count = %d\n, offset=%d", count, offset);
-    vop_write(destnode, buf, offset, count);
-    offset += 512;
+  r = -1;
+  if(pathcopy(path, destpath, sizeof(path)) != 0){
+    name = srcpath + strlen(srcpath);
+    while(name > srcpath && name[-1] != '/' && name[-1] != ':')
+      name--;
+    n = strlen(path);
+    if(!intodir)
+      r = copyfile(srcnode, path);
+    else if(n + 1 + strlen(name) < sizeof(path)){
+      path[n] = '/';
+      safestrcpy(path + n + 1, name, sizeof(path) - n - 1);
+      r = copyfile(srcnode, path);
+    }
   }
-//  cprintf("enter sys_copy7\n");
-  vop_iunlock(srcnode);
+  if(r < 0)
+    cprintf("cp: can not copy to %s!\n", destpath);
+  begin_trans();
   vop_ref_dec(srcnode);
   commit_trans();
-  return 0;
+  return r;
 }
 
 int
@@ -489,85 +584,109 @@ sys_move(void)
   $mv c.txt /home/vamei
   c.txtƶ/home/vameiĿ¼
   */
-  begin_trans();
- 
-  char *srcpath, *destpath, srcparentname[260], temppath[100];// destparentname[260];
-  struct inode *srcnode, *destnode, *srcptnode;//, *destptnode;
+  char *srcpath, *destpath, path[128];
+  char srcname[FAT_DIRSIZ + 1], destname[FAT_DIRSIZ + 1];
+  struct inode *srcnode, *destnode, *srcdp, *destdp;
+  int r, n, intodir;
+
   if(argstr(0, &srcpath) < 0 || argstr(1, &destpath) < 0)
   {
     cprintf("mv: path error!\n");
-    commit_trans();
     return -1;
   }
-  if((srcnode = vfs_lookup(srcpath)) == 0)
+  if(pathcopy(path, srcpath, sizeof(path)) == 0 || (srcnode = vfs_lookup(path)) == 0)
   {
     cprintf("mv: source file does not exits!\n");
-    commit_trans();
     return -1;
   }
+  vop_ilock(srcnode);
   if(vop_gettype(srcnode) != T_FILE)
   {
     cprintf("mv: source path is not a file!\n");
-    commit_trans();
+    vop_iunlockput(srcnode);
+    return -1;
+  }
+  vop_iunlock(srcnode);
+  pathcopy(path, srcpath, sizeof(path));
+  if((srcdp = vfs_lookup_parent(path, srcname)) == 0)
+  {
+    cprintf("mv: src parent path error!\n");
+    vop_ref_dec(srcnode);
     return -1;
   }
 
-  strncpy((char*)temppath, destpath, strlen(destpath));
-  if((destnode = vfs_lookup(temppath)) && vop_gettype(destnode) == T_DIR)
+  // Moving to a directory keeps the name.
+  destdp = 0;
+  intodir = 0;
+  if(pathcopy(path, destpath, sizeof(path)) != 0 && (destnode = vfs_lookup(path)) != 0){
+    vop_ilock(destnode);
+    if(vop_gettype(destnode) == T_DIR){
+      vop_iunlock(destnode);
+      destdp = destnode;
+      intodir = 1;
+      safestrcpy(destname, srcname, sizeof(destname));
+    } else
+      vop_iunlockput(destnode);
+  }
+  if(destdp == 0 && (pathcopy(path, destpath, sizeof(path)) == 0 ||
+                     (destdp = vfs_lookup_parent(path, destname)) == 0))
   {
-    char* srcfilename = &srcpath[strlen(srcpath)-1];
-    while(*srcfilename != '/' && srcfilename != srcpath){
-      srcfilename--;    
+    cprintf("mv: dest path error!\n");
+    vop_ref_dec(srcdp);
+    vop_ref_dec(srcnode);
+    return -1;
+  }
+
+  if(srcdp->fstype == destdp->fstype && srcdp->in_dev == destdp->in_dev){
+    // Same volume: just move the entry, replacing a file
+    // that has the new name.
+    begin_trans();
+    vop_ilock(destdp);
+    destnode = vop_dirlookup(destdp, destname, 0);
+    vop_iunlock(destdp);
+    r = 0;
+    if(destnode != 0 && destnode != srcnode){
+      vop_ilock(destnode);
+      if(vop_gettype(destnode) != T_FILE)
+        r = -1;
+      vop_iunlock(destnode);
+      if(r == 0)
+        r = vop_unlink(vop_ref_inc(destdp), destname);
     }
-    char* destfullpath = &destpath[strlen(destpath)];
-    if(*srcfilename != '/')
-    {
-      *destfullpath = '/';
-      destfullpath++;
-    }   
-    while(*srcfilename != 0)
-    {
-      *destfullpath = *srcfilename;
-      destfullpath++;
-      srcfilename++;
+    if(r == 0 && destnode != srcnode)
+      r = vop_rename(srcdp, srcname, destdp, destname);
+    vop_ref_dec(destdp);
+    vop_ref_dec(srcdp);
+    vop_ref_dec(srcnode);
+    commit_trans();
+    // Freeing the file that was replaced logs its bitmap and
+    // extent sectors too, so it gets a transaction of its own.
+    if(destnode != 0){
+      begin_trans();
+      vop_ref_dec(destnode);
+      commit_trans();
     }
-    *destfullpath = 0;
+    return r;
   }
-  else
-  {
-    // if((destptnode = vfs_lookup_parent(destpath, destparentname)) == 0)
-    // {
-    //   cprintf("mv: dest path error!\n");
-    //   commit_trans();
-    //   return -1;
-    // } 
-  }
-  if((destnode = create(destpath, T_FILE, vop_getmajor(srcnode), vop_getminor(srcnode))) == 0)
-  {
-    cprintf("mv: can not create destination's inode!\n");
-    commit_trans();
-    return -1;
+
+  // Across volumes the data has to be copied.
+  r = -1;
+  pathcopy(path, destpath, sizeof(path));
+  if(intodir && (n = strlen(path)) + 1 + strlen(srcname) < sizeof(path)){
+    path[n] = '/';
+    safestrcpy(path + n + 1, srcname, sizeof(path) - n - 1);
   }
-  vop_iunlockput(destnode);
-  vop_ilock(srcnode);
-  int offset = 0, count;
-  char buf[512];  
-  while((count = vop_read(srcnode, buf, offset, 512)) > 0)
-  {
-    vop_write(destnode, buf, offset, count);
-    offset += 512;
+  if(copyfile(srcnode, path) == 0){
+    begin_trans();
+    r = vop_unlink(vop_ref_inc(srcdp), srcname);
+    commit_trans();
   }
-  vop_iunlock(srcnode);
+  begin_trans();
+  vop_ref_dec(destdp);
+  vop_ref_dec(srcdp);
   vop_ref_dec(srcnode);
-  if((srcptnode = vfs_lookup_parent(srcpath, srcparentname)) == 0)
-  {
-    cprintf("mv: src parent path error!\n");
-    commit_trans();
-    return -1;
-  } 
-  vop_unlink(srcptnode, srcpath);
   commit_trans();
-  return 0;
+  return r;
 }
 
 // sb serie: sys_ with argument(s)
@@ -633,6 +752,7 @@ sb_open(char* path, int omode) {
   f->off = 0;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+  f->append = (omode & O_APPEND) != 0;
   // cprintf("finish sbopen\n");
   return fd;
 }
@@ -662,6 +782,14 @@ sb_read(int fd, void* p, int n) {
   return fileread(f, p, n);
 }
 
+int
+sb_getdents(int fd, void* p, int n) {
+  struct file *f;
+  if ((f = proc->ofile[fd]) == 0)
+    return -1;
+  return filegetdents(f, p, n);
+}
+
 int
 sb_close(int fd) {
   struct file *f;
@@ -732,7 +860,6 @@ sb_remove(char* path) {
   struct inode *dp;
   char name[DIRSIZ];
   uint off;
-  int fstype;
 
   if((dp = vfs_lookup_parent(path, name)) == 0) {
     cprintf("sbremove: can't remove root folder\n");
@@ -743,12 +870,11 @@ sb_remove(char* path) {
   // lock dp no need !!!!!! alredy
 
   struct inode* ip;
-  char buf[512], *p;
-  int fd;
+  char buf[512];
+  int fd, n, i;
   struct stat st;
   char combine[512];
-  
-  struct sfs_dirent sfs_de;
+  struct dirent *de;
 
   // struct LDIR fat_de;
   // struct DIR *dir;
@@ -762,7 +888,6 @@ sb_remove(char* path) {
     goto bad;
   if ((ip = vop_dirlookup(dp, name, &off)) == 0)
     goto bad;
-  fstype = dp->fstype;
   //vop_iunlockput(dp);
   
   // struct sfs_inode *tip = vop_info(ip, sfs_inode);
@@ -789,50 +914,38 @@ sb_remove(char* path) {
       sb_unlink(path);
     } else { // ip is non-empty
       vop_iunlockput(ip);
-      if (fstype == SFS_INODE) {
-        // cprintf("we can only use rm -r in sfs\n");
-        if ((fd = sb_open(path, 0)) < 0) {//
-          cprintf("sbremove: can't open\n");
-          goto bad;
-        }
-        if (sb_fstat(fd, &st) < 0) {
-          cprintf("sbremove: can't stat\n");
-          goto bad;
-        }
-        if (strlen(name)+1+DIRSIZ+1 > sizeof buf) {
-          cprintf("sbremove: path too long\n");
-          goto bad;
-        }
-        sb_strcpy(buf, name);
-        p = buf + strlen(buf);
-        *p++ = '/';
-        while (sb_read(fd, &sfs_de, sizeof(sfs_de)) == sizeof(sfs_de)) {
-          if (sfs_de.inum == 0)
+      if ((fd = sb_open(path, 0)) < 0) {//
+        cprintf("sbremove: can't open\n");
+        goto bad;
+      }
+      if (sb_fstat(fd, &st) < 0) {
+        cprintf("sbremove: can't stat\n");
+        sb_close(fd);
+        goto bad;
+      }
+      // buf takes a batch of entries at a time; this works on both
+      // file systems, and keeps the stack small as we recurse.
+      while ((n = sb_getdents(fd, buf, sizeof(buf))) > 0) {
+        for (i = 0; i < n; i += de->reclen) {
+          de = (struct dirent*)(buf + i);
+          if (sb_strcmp(de->name, ".") == 0 || sb_strcmp(de->name, "..") == 0)
             continue;
-          if (sb_strcmp(sfs_de.name, ".") == 0 || sb_strcmp(sfs_de.name, "..") == 0)
+          if (sb_strlen(path) + 1 + de->namlen + 1 > sizeof combine) {
+            cprintf("sbremove: path too long\n");
             continue;
-          memmove(p, sfs_de.name, DIRSIZ);
-          p[DIRSIZ] = 0;
+          }
           // rebuild full path
           sb_strcpy(combine, "");
           sb_strcat(combine, path);
           sb_strcat(combine, "/");
-          sb_strcat(combine, sfs_de.name);
+          sb_strcat(combine, de->name);
           // cprintf("sbremove:before sbstat path=%s\n", path);
           // cprintf("sbremove:before sbstat combine=%s\n", combine);
           sb_remove(combine);
           sb_unlink(path);
-        } // end while
-      }
-      else if (fstype == FAT_INODE) {
-        //...
-        cprintf("sbremove: fat not yet\n");
-        goto bad;
-      }
-      else {
-        cprintf("sbremove: invalid inode type\n");
-        goto bad;
-      }
+        }
+      } // end while
+      sb_close(fd);
     } // endif (empty or not)
   }
 
@@ -850,7 +963,6 @@ sys_remove(void)
   struct inode *dp;
   char name[DIRSIZ], *path;
   uint off;
-  int fstype;
 
   if (argstr(0, &path) < 0) {
     cprintf("remove: wrong path arg\n");
@@ -865,10 +977,10 @@ sys_remove(void)
 
   struct inode* ip;
   char buf[512], *p;
-  int fd;
+  char dents[512];
+  int fd, n, i;
   struct stat st;
-  
-  struct sfs_dirent sfs_de;
+  struct dirent *de;
 
   // struct LDIR fat_de;
   // struct DIR *dir;
@@ -883,7 +995,6 @@ sys_remove(void)
   if ((ip = vop_dirlookup(dp, name, &off)) == 0)
     goto bad;
 
-  fstype = dp->fstype;
   vop_iunlockput(dp);
   
   vop_ilock(ip);
@@ -903,46 +1014,37 @@ sys_remove(void)
       sb_unlink(name);
     } else { // ip is non-empty
       vop_iunlockput(ip);
-      if (fstype == SFS_INODE) {
-        if ((fd = sb_open(path, 0)) < 0) {
-          cprintf("remove: can't open\n");
-          goto bad;
-        }
-        if (sb_fstat(fd, &st) < 0) {
-          cprintf("remove: can't stat\n");
-          goto bad;
-        }
-        if (strlen(name)+1+DIRSIZ+1 > sizeof buf) {
-          cprintf("remove: path too long\n");
-          goto bad;
-        }
-        sb_strcpy(buf, name);
-        p = buf + strlen(buf);
-        *p++ = '/';
-        while (sb_read(fd, &sfs_de, sizeof(sfs_de)) == sizeof(sfs_de)) {
-          if (sfs_de.inum == 0)
+      if ((fd = sb_open(path, 0)) < 0) {
+        cprintf("remove: can't open\n");
+        goto bad;
+      }
+      if (sb_fstat(fd, &st) < 0) {
+        cprintf("remove: can't stat\n");
+        sb_close(fd);
+        goto bad;
+      }
+      sb_strcpy(buf, name);
+      p = buf + strlen(buf);
+      *p++ = '/';
+      while ((n = sb_getdents(fd, dents, sizeof(dents))) > 0) {
+        for (i = 0; i < n; i += de->reclen) {
+          de = (struct dirent*)(dents + i);
+          if (sb_strcmp(de->name, ".") == 0 || sb_strcmp(de->name, "..") == 0)
             continue;
-          if (sb_strcmp(sfs_de.name, ".") == 0 || sb_strcmp(sfs_de.name, "..") == 0)
+          if (p - buf + de->namlen + 1 > sizeof buf) {
+            cprintf("remove: path too long\n");
             continue;
-          memmove(p, sfs_de.name, DIRSIZ);
-          p[DIRSIZ] = 0;
+          }
+          memmove(p, de->name, de->namlen + 1);
           // cprintf("path=%s ", path);
           // cprintf("buf=%s ", buf);
           // cprintf("buftail=%s ", sb_fmtname(buf));
           // cprintf("name=%s\n", name);
           sb_remove(buf);
           sb_unlink(name);
-        } // end while
-      }
-      else if (fstype == FAT_INODE) {
-        //...
-        cprintf("remove: fat not yet\n");
-        goto bad;
-      }
-      else {
-        cprintf("remove: invalid inode type\n");
-        goto bad;
-      }
+        }
+      } // end while
+      sb_close(fd);
     } // endif (empty or not)
   }
 
@@ -1003,7 +1105,66 @@ int sys_touch(void)
   return 0;
 }
 
-int sys_find(void)
+// Walk the tree under a directory, collecting the paths
+// of the entries that match a name pattern and a type.
+int
+sys_find(void)
 {
-  return 0;
-}
\ No newline at end of file
+  char *path, *pat, *buf;
+  int type, n;
+  struct findcursor *cur;
+
+  if(argstr(0, &path) < 0 || argstr(1, &pat) < 0 || argint(2, &type) < 0 ||
+     argint(4, &n) < 0 || argwptr(3, &buf, n) < 0 || argwptr(5, (void*)&cur, sizeof(*cur)) < 0)
+    return -1;
+  return vfs_find(path, pat, type, buf, n, cur);
+}
+
+int
+sys_mount(void)
+{
+  int dev;
+  char *path, *type;
+
+  if(argint(0, &dev) < 0 || argstr(1, &path) < 0 || argstr(2, &type) < 0 || dev < 0)
+    return -1;
+  return vfs_mount(dev, path, type);
+}
+
+int
+sys_umount(void)
+{
+  char *path;
+  int r;
+
+  if(argstr(0, &path) < 0)
+    return -1;
+  // Dropping the volume's cached inodes may write them back.
+  begin_trans();
+  r = vfs_umount(path);
+  commit_trans();
+  return r;
+}
+
+int
+sys_mmap(void)
+{
+  struct file *f;
+  int len, prot, flags, off;
+
+  // The address hint, argument 0, is not used.
+  if(argint(1, &len) < 0 || argint(2, &prot) < 0 || argint(3, &flags) < 0 ||
+     argfd(4, 0, &f) < 0 || argint(5, &off) < 0)
+    return -1;
+  return mmap(f, len, prot, flags, off);
+}
+
+int
+sys_munmap(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0)
+    return -1;
+  return munmap(addr, len);
+}
@@ -0,0 +1,271 @@
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "stat.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "inode.h"
+#include "vfs.h"
+
+/* *
+ * Directory entry cache.
+ *
+ * Maps (directory, name) to the inode the name refers to, or to
+ * nothing for a name known not to exist. A positive entry holds a
+ * reference to its inode. The directory is identified by its icache
+ * entry together with that entry's in_gen, so entries of a directory
+ * that has left the icache can never match again; they just age out.
+ * An entry is hashed by the gen it recorded, not by its directory's
+ * current in_gen, so that it can still be unhashed once the icache
+ * entry has been reused.
+ *
+ * Entries of a directory are only consulted and created while the
+ * directory is locked, if only shared. Changes to a directory go
+ * through vfs_dirlink, vfs_unlink, vfs_rename and vfs_create_inode,
+ * which purge the entries they may have made stale.
+ * */
+
+#define NDCACHE                     64
+#define NDHASH                      31
+#define DCNAMELEN                   28  // longer names are not cached
+
+struct dentry {
+    struct inode *parent;           // 0 if the entry is unused
+    uint pgen;                      // parent->in_gen when entered
+    char name[DCNAMELEN];
+    struct inode *node;             // 0 for a negative entry
+    struct dentry *hnext;           // hash chain
+    struct dentry *prev;            // LRU list
+    struct dentry *next;
+};
+
+static struct {
+    struct spinlock lock;
+    struct dentry entry[NDCACHE];
+    struct dentry *hash[NDHASH];
+    // Linked list of all entries, through prev/next.
+    // head.next is most recently used.
+    struct dentry head;
+} dcache;
+
+void
+dcache_init(void) {
+    struct dentry *d;
+
+    initlock(&dcache.lock, "dcache");
+    dcache.head.prev = &dcache.head;
+    dcache.head.next = &dcache.head;
+    for (d = dcache.entry; d < dcache.entry + NDCACHE; d ++) {
+        d->next = dcache.head.next;
+        d->prev = &dcache.head;
+        dcache.head.next->prev = d;
+        dcache.head.next = d;
+    }
+}
+
+// The parent's in_gen is passed separately: an entry's parent may have
+// been freed and reused, and is then hashed by the gen it had.
+static uint
+dcache_hash(struct inode *dp, uint gen, const char *name) {
+    uint h = (uint)dp ^ gen;
+    while (*name != '\0') {
+        h = h * 31 + *name ++;
+    }
+    return h % NDHASH;
+}
+
+static struct dentry *
+dcache_find(struct inode *dp, const char *name) {
+    struct dentry *d;
+    for (d = dcache.hash[dcache_hash(dp, dp->in_gen, name)]; d != 0; d = d->hnext) {
+        if (d->parent == dp && d->pgen == dp->in_gen && strncmp(d->name, name, DCNAMELEN) == 0) {
+            return d;
+        }
+    }
+    return 0;
+}
+
+// Move d to the front of the LRU list.
+static void
+dcache_touch(struct dentry *d) {
+    d->next->prev = d->prev;
+    d->prev->next = d->next;
+    d->next = dcache.head.next;
+    d->prev = &dcache.head;
+    dcache.head.next->prev = d;
+    dcache.head.next = d;
+}
+
+// Take d out of its hash chain and mark it unused.
+// Returns the inode whose reference the caller must drop.
+static struct inode *
+dcache_unhash(struct dentry *d) {
+    struct dentry **pp;
+    struct inode *node;
+
+    for (pp = &dcache.hash[dcache_hash(d->parent, d->pgen, d->name)]; *pp != d; pp = &(*pp)->hnext) {
+        if (*pp == 0) {
+            panic("dcache_unhash");
+        }
+    }
+    *pp = d->hnext;
+    node = d->node;
+    d->parent = 0;
+    d->node = 0;
+    return node;
+}
+
+static int
+dcache_cacheable(const char *name) {
+    // "." is handled by the caller and ".." would pin ancestors.
+    if (strncmp(name, ".", 2) == 0 || strncmp(name, "..", 3) == 0) {
+        return 0;
+    }
+    return strlen(name) < DCNAMELEN;
+}
+
+/* *
+ * dcache_lookup - look name up in directory dp, which the caller has locked.
+ * Returns 0 on a miss. On a hit, *node_store is set to a new reference to the
+ * inode, or to 0 if the name is known not to exist.
+ * */
+int
+dcache_lookup(struct inode *dp, const char *name, struct inode **node_store) {
+    struct dentry *d;
+
+    if (!dcache_cacheable(name)) {
+        return 0;
+    }
+    acquire(&dcache.lock);
+    if ((d = dcache_find(dp, name)) == 0) {
+        release(&dcache.lock);
+        return 0;
+    }
+    dcache_touch(d);
+    *node_store = d->node;
+    if (d->node != 0) {
+        vop_ref_inc(d->node);
+    }
+    release(&dcache.lock);
+    return 1;
+}
+
+/* *
+ * dcache_enter - record the result of looking name up in directory dp,
+ * which the caller has locked; node is 0 if the name does not exist.
+ * */
+void
+dcache_enter(struct inode *dp, const char *name, struct inode *node) {
+    struct dentry *d;
+    struct inode *old;
+    uint h;
+
+    if (!dcache_cacheable(name)) {
+        return;
+    }
+    old = 0;
+    acquire(&dcache.lock);
+    if ((d = dcache_find(dp, name)) == 0) {
+        // Recycle the least recently used entry.
+        d = dcache.head.prev;
+        if (d->parent != 0) {
+            old = dcache_unhash(d);
+        }
+        d->parent = dp;
+        d->pgen = dp->in_gen;
+        safestrcpy(d->name, name, DCNAMELEN);
+        h = dcache_hash(dp, dp->in_gen, name);
+        d->hnext = dcache.hash[h];
+        dcache.hash[h] = d;
+    } else {
+        old = d->node;
+    }
+    d->node = node;
+    if (node != 0) {
+        vop_ref_inc(node);
+    }
+    dcache_touch(d);
+    release(&dcache.lock);
+    if (old != 0) {
+        vop_ref_dec(old);
+    }
+}
+
+/* *
+ * dcache_purge - drop the entries of directory dp; if negative_only is set,
+ * only those recording that a name does not exist.
+ * */
+void
+dcache_purge(struct inode *dp, int negative_only) {
+    struct dentry *d;
+    struct inode *node;
+
+again:
+    acquire(&dcache.lock);
+    for (d = dcache.head.next; d != &dcache.head; d = d->next) {
+        if (d->parent == dp && d->pgen == dp->in_gen && (!negative_only || d->node == 0)) {
+            node = dcache_unhash(d);
+            if (node != 0) {
+                // Dropping the reference may sleep: do it unlocked.
+                release(&dcache.lock);
+                vop_ref_dec(node);
+                goto again;
+            }
+        }
+    }
+    release(&dcache.lock);
+}
+
+/* *
+ * dcache_purge_fs - drop the entries for inodes of the file system on
+ * (fstype, dev), which is being unmounted
+ * */
+void
+dcache_purge_fs(int fstype, uint dev) {
+    struct dentry *d;
+    struct inode *node;
+
+again:
+    acquire(&dcache.lock);
+    for (d = dcache.head.next; d != &dcache.head; d = d->next) {
+        if (d->parent != 0 && d->node != 0 && d->node->fstype == fstype && d->node->in_dev == dev) {
+            node = dcache_unhash(d);
+            release(&dcache.lock);
+            vop_ref_dec(node);
+            goto again;
+        }
+    }
+    release(&dcache.lock);
+}
+
+/* *
+ * dcache_getpath - build the path of directory node within its file system
+ * from the cached entries leading to it from the file system's root. The
+ * "name/" elements are placed right to left so that they end at path[pos];
+ * returns where they start, or -1 if some entry on the way is not cached
+ * or the path does not fit.
+ * */
+int
+dcache_getpath(struct inode *node, char *path, int pos) {
+    struct dentry *d;
+    int len;
+
+    acquire(&dcache.lock);
+    while (!vfs_isroot(node)) {
+        for (d = dcache.head.next; d != &dcache.head; d = d->next) {
+            if (d->parent != 0 && d->node == node && d->pgen == d->parent->in_gen) {
+                break;
+            }
+        }
+        if (d == &dcache.head || (len = strlen(d->name)) + 1 > pos) {
+            release(&dcache.lock);
+            return -1;
+        }
+        pos -= len + 1;
+        memmove(path + pos, d->name, len);
+        path[pos + len] = '/';
+        node = d->parent;
+    }
+    release(&dcache.lock);
+    return pos;
+}
@@ -0,0 +1,211 @@
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "stat.h"
+#include "mmu.h"
+#include "inode.h"
+#include "vfs.h"
+
+/* *
+ * Tree walk for find.
+ *
+ * The walk reads each directory with vop_readdir and goes down into
+ * subdirectories as it meets them, keeping a stack of the directories
+ * it is in. Matching paths are packed into the caller's buffer, each
+ * ending in a NUL. When the buffer is full the walk stops and leaves
+ * a struct findcursor saying where it was: for each level, the cookie
+ * of the entry it went down through, and for the last one the cookie
+ * of the entry it could not report. The next call goes down the same
+ * entries again without reporting them and carries on from there.
+ * */
+
+#define FINDPATH                    512
+
+struct findlevel {
+    struct inode *node;
+    uint cookie;                    // entry to read next, or the one gone down through
+    uint next;                      // entry after that one
+    int pathlen;                    // length of the path of node
+    int reenter;                    // go down through the entry at cookie unreported
+};
+
+struct findstate {
+    struct findlevel level[FINDDEPTH + 1];
+    char path[FINDPATH];
+    char dents[1024];
+};
+
+// Does name match pattern pat, in which '*' matches any string
+// and '?' any one character?
+static int
+find_match(const char *pat, const char *name) {
+    const char *star = 0, *back = 0;
+
+    while (*name != '\0') {
+        if (*pat == '*') {
+            star = ++ pat;
+            back = name;
+        } else if (*pat == '?' || *pat == *name) {
+            pat ++, name ++;
+        } else if (star != 0) {
+            pat = star;
+            name = ++ back;
+        } else {
+            return 0;
+        }
+    }
+    while (*pat == '*') {
+        pat ++;
+    }
+    return *pat == '\0';
+}
+
+// Dropping the last reference to an unlinked inode frees it.
+static void
+find_put(struct inode *node) {
+    begin_trans();
+    vop_ref_dec(node);
+    commit_trans();
+}
+
+/* *
+ * vfs_find - walk the tree under directory path, packing into buf, which
+ * has room for n bytes, the paths of the entries whose names match pat
+ * and, unless type is 0, whose type is type. Returns the number of bytes
+ * used, 0 once the walk is complete, or -1 on error or if not even one
+ * path fits. cur says where to start, and is updated to where to go on.
+ * */
+int
+vfs_find(char *path, const char *pat, int type, char *buf, int n, struct findcursor *cur) {
+    struct findstate *fs;
+    struct findlevel *lv;
+    struct dirent *de;
+    struct inode *node, *child;
+    int depth, i, r, len, tot, reenter;
+    uint cookie, start;
+
+    depth = cur->depth;
+    if (depth < 0) {
+        return 0;
+    }
+    if (depth > FINDDEPTH || (len = strlen(path)) >= FINDPATH) {
+        return -1;
+    }
+    if ((fs = (struct findstate *)kalloc()) == 0) {
+        return -1;
+    }
+    memmove(fs->path, path, len);
+    if ((node = vfs_lookup(path)) == 0) {
+        kfree((char *)fs);
+        return -1;
+    }
+    while (len > 0 && fs->path[len - 1] == '/') {
+        len --;
+    }
+
+    lv = fs->level;
+    lv->node = node;
+    lv->cookie = cur->cookie[0];
+    lv->pathlen = len;
+    lv->reenter = depth > 0;
+    tot = 0;
+    for (;;) {
+        node = lv->node;
+        vop_ilock_shared(node);
+        if (vop_gettype(node) != T_DIR) {
+            vop_iunlock(node);
+            r = -1;
+            break;
+        }
+        start = cookie = lv->cookie;
+        if ((r = vop_readdir(node, fs->dents, sizeof(fs->dents), &cookie)) <= 0) {
+            vop_iunlock(node);
+            if (r < 0 || lv == fs->level) {
+                break;
+            }
+            // Done with this directory; back up to its parent.
+            find_put(node);
+            lv --;
+            lv->cookie = lv->next;
+            continue;
+        }
+
+        child = 0;
+        reenter = 0;
+        for (i = 0; i < r; i += de->reclen, start = de->off) {
+            de = (struct dirent *)(fs->dents + i);
+            if (strncmp(de->name, ".", 2) == 0 || strncmp(de->name, "..", 3) == 0) {
+                continue;
+            }
+            if ((len = lv->pathlen + 1 + de->namlen) >= FINDPATH) {
+                continue;
+            }
+            reenter = lv->reenter;
+            lv->reenter = 0;
+            if (!reenter && find_match(pat, de->name) && (type == 0 || de->type == type)) {
+                if (tot + len + 1 > n) {
+                    vop_iunlock(node);
+                    goto full;
+                }
+                memmove(buf + tot, fs->path, lv->pathlen);
+                buf[tot + lv->pathlen] = '/';
+                memmove(buf + tot + lv->pathlen + 1, de->name, de->namlen + 1);
+                tot += len + 1;
+            }
+            if (de->type != T_DIR || lv == fs->level + FINDDEPTH) {
+                continue;
+            }
+            if (!dcache_lookup(node, de->name, &child)) {
+                child = vop_dirlookup(node, de->name, 0);
+                dcache_enter(node, de->name, child);
+            }
+            if (child != 0) {
+                break;
+            }
+        }
+        vop_iunlock(node);
+        if (child == 0) {
+            lv->cookie = cookie;
+            continue;
+        }
+
+        // Go down into child, through the entry at start.
+        lv->cookie = start;
+        lv->next = de->off;
+        fs->path[lv->pathlen] = '/';
+        memmove(fs->path + lv->pathlen + 1, de->name, de->namlen);
+        lv ++;
+        lv->node = vfs_cross(child);
+        lv->pathlen = len;
+        lv->cookie = 0;
+        lv->reenter = 0;
+        if (reenter) {
+            lv->cookie = cur->cookie[lv - fs->level];
+            lv->reenter = lv - fs->level < depth;
+        }
+    }
+
+    // The walk is over, or failed.
+    for (; lv >= fs->level; lv --) {
+        find_put(lv->node);
+    }
+    kfree((char *)fs);
+    if (r < 0) {
+        return -1;
+    }
+    cur->depth = -1;
+    return tot;
+
+full:
+    // Out of room: start again from the entry at start next time.
+    cur->depth = lv - fs->level;
+    for (i = 0; i < cur->depth; i ++) {
+        cur->cookie[i] = fs->level[i].cookie;
+    }
+    cur->cookie[cur->depth] = start;
+    for (; lv >= fs->level; lv --) {
+        find_put(lv->node);
+    }
+    kfree((char *)fs);
+    return tot > 0 ? tot : -1;
+}
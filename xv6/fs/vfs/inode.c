@@ -15,4 +15,99 @@ inode_init(struct inode *node, const struct inode_ops *ops, int fstype) {
     node->fstype = fstype;
 //    vop_ref_inc(node);
 //    cprintf("finish inode_init, fstype = %d\n", fstype);
-}
\ No newline at end of file
+}
+
+struct icache_universal icache;
+
+/* *
+ * icache_init - make the object cache inodes come from. Its memory is
+ * never given back, so a dentry or page cache entry may keep a pointer
+ * to an inode that has been freed: the pointer is only ever compared,
+ * along with in_gen, against inodes that are in use.
+ * */
+void
+icache_init(void) {
+    icache.cache = kcachecreate("inode", sizeof(struct inode), KC_KEEP);
+}
+
+static uint
+icache_hash(int fstype, uint dev, uint inum) {
+    return (fstype * 31 + dev * 17 + inum) % NIHASH;
+}
+
+/* *
+ * icache_lookup - find the cached inode for (fstype, dev, inum)
+ * return NULL if it has no references; caller holds icache.lock
+ * */
+struct inode *
+icache_lookup(int fstype, uint dev, uint inum) {
+    struct inode *node;
+    for (node = icache.hash[icache_hash(fstype, dev, inum)]; node != 0; node = node->in_next) {
+        if (node->fstype == fstype && node->in_dev == dev && node->in_inum == inum) {
+            return node;
+        }
+    }
+    return 0;
+}
+
+/* *
+ * icache_alloc - allocate a cleared inode and hash it under the given key;
+ * caller holds icache.lock and fills in the fs-specific part
+ * */
+struct inode *
+icache_alloc(int fstype, uint dev, uint inum) {
+    struct inode *node;
+    uint h;
+
+    if ((node = kcachealloc(icache.cache)) == 0) {
+        panic("iget: no inodes");
+    }
+    memset(node, 0, sizeof(*node));
+    node->fstype = fstype;
+    node->in_dev = dev;
+    node->in_inum = inum;
+    node->in_gen = ++ icache.gen;
+    h = icache_hash(fstype, dev, inum);
+    node->in_next = icache.hash[h];
+    icache.hash[h] = node;
+    return node;
+}
+
+/* *
+ * icache_free - unhash an inode whose last reference is gone and free
+ * it; caller holds icache.lock
+ * */
+void
+icache_free(struct inode *node) {
+    struct inode **pp;
+
+    for (pp = &icache.hash[icache_hash(node->fstype, node->in_dev, node->in_inum)]; *pp != 0; pp = &(*pp)->in_next) {
+        if (*pp == node) {
+            *pp = node->in_next;
+            kcachefree(icache.cache, node);
+            return;
+        }
+    }
+    panic("icache_free: not hashed");
+}
+
+/* *
+ * icache_busy - is any inode of the file system on (fstype, dev) in use?
+ * */
+int
+icache_busy(int fstype, uint dev) {
+    struct inode *node;
+    int i;
+
+    acquire(&icache.lock);
+    for (i = 0; i < NIHASH; i ++) {
+        for (node = icache.hash[i]; node != 0; node = node->in_next) {
+            if (node->fstype == fstype && node->in_dev == dev) {
+                release(&icache.lock);
+                return 1;
+            }
+        }
+    }
+    release(&icache.lock);
+    return 0;
+}
@@ -6,6 +6,8 @@
 
 #include "spinlock.h"
 
+struct vfs_mount;
+
 struct inode {
     union {
         struct sfs_inode __sfs_inode_info;
@@ -13,13 +15,27 @@ struct inode {
     } in_info;
     int fstype;
     const struct inode_ops *in_ops;
+    uint in_dev;                    // cache key, with fstype
+    uint in_inum;
+    uint in_gen;                    // distinguishes reuses of the entry
+    struct inode *in_next;          // hash chain
+    struct vfs_mount *in_mnt;       // volume mounted on this directory
 };
 
+#define NIHASH                              61
+
+// Inodes with a reference are hashed by (fstype, dev, inum);
+// entries whose last reference is dropped go back to the
+// object cache they came from.
 struct icache_universal {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *hash[NIHASH];
+  struct kcache *cache;
+  uint gen;
 };
 
+extern struct icache_universal icache;
+
 #define __vop_info(node, type)                                      \
     ({                                                              \
         struct inode *__node = (node);                              \
@@ -29,6 +45,17 @@ struct icache_universal {
 #define vop_info(node, type)                                        __vop_info(node, type)
 
 void inode_init(struct inode *node, const struct inode_ops *ops, int fstype);
+struct inode *icache_lookup(int fstype, uint dev, uint inum);
+struct inode *icache_alloc(int fstype, uint dev, uint inum);
+void icache_free(struct inode *node);
+int icache_busy(int fstype, uint dev);
+
+int vfs_read(struct inode *node, char *dst, uint off, uint n);
+int vfs_write(struct inode *node, char *src, uint off, uint n);
+int vfs_dirlink(struct inode *dp, char *name, struct inode *node);
+int vfs_unlink(struct inode *dp, char *name);
+int vfs_rename(struct inode *olddp, char *oldname, struct inode *newdp, char *newname);
+struct inode *vfs_create_inode(struct inode *dirnode, short type, short major, short minor, char *name);
 
 #define VOP_MAGIC                           0x8c4ba476
 
@@ -40,12 +67,11 @@ struct inode_ops {
     void (*vop_fstat)(struct inode *ip, struct stat *st);
     struct inode* (*vop_ref_inc)(struct inode *ip);
     void (*vop_ref_dec)(struct inode *ip);
-    struct inode* (*vop_namei)(struct inode *node, char *path);
-    struct inode* (*vop_nameiparent)(struct inode *node, char *path, char *name);
     int (*vop_dirlink)(struct inode *dp, char *name, struct inode *originip);
     int (*vop_unlink)(struct inode *dp, char *name);
     struct inode* (*vop_dirlookup)(struct inode *dp, char *name, uint *poff);
     void (*vop_ilock)(struct inode *ip);
+    void (*vop_ilock_shared)(struct inode *ip);
     void (*vop_iunlock)(struct inode *ip);
     void (*vop_iunlockput)(struct inode *ip);
     void (*vop_iupdate)(struct inode *ip);
@@ -61,6 +87,9 @@ struct inode_ops {
     int (*vop_getpath)(struct inode *node, char *path, int maxlen);
     short (*vop_getmajor)(struct inode *node);
     short (*vop_getminor)(struct inode *node);
+    int (*vop_readdir)(struct inode *dp, char *dst, uint n, uint *cookie);
+    int (*vop_rename)(struct inode *olddp, char *oldname, struct inode *newdp, char *newname);
+    void (*vop_readahead)(struct inode *ip, uint off, uint n);
 };
 
 #define __vop_op(node, sym)                                                                         \
@@ -69,19 +98,21 @@ struct inode_ops {
         __node->in_ops->vop_##sym;                                                                  \
      })
 
-#define vop_read(ip, dst, off, n)                       (__vop_op(ip, read)(ip, dst, off, n))
-#define vop_write(ip, src, off, n)                      (__vop_op(ip, write)(ip, src, off, n))
+#define vop_read(ip, dst, off, n)                       vfs_read(ip, dst, off, n)
+#define vop_write(ip, src, off, n)                      vfs_write(ip, src, off, n)
 #define vop_fstat(ip, st)                               (__vop_op(ip, fstat)(ip, st))
 #define vop_getmajor(node)                              (__vop_op(node, getmajor)(node))
 #define vop_getminor(node)                              (__vop_op(node, getminor)(node))
 #define vop_ref_inc(ip)                                 (__vop_op(ip, ref_inc)(ip))
 #define vop_ref_dec(ip)                                 (__vop_op(ip, ref_dec)(ip))
-#define vop_namei(node, path)                           (__vop_op(node, namei)(node, path))
-#define vop_nameiparent(node, path, name)               (__vop_op(node, nameiparent)(node, path, name))
-#define vop_dirlink(dp, name, originip)                 (__vop_op(dp, dirlink)(dp, name, originip))
-#define vop_unlink(dp, name)                            (__vop_op(dp, unlink)(dp, name))
+// Operations that change a directory go through the VFS so that
+// it can invalidate the dentry cache.
+#define vop_dirlink(dp, name, originip)                 vfs_dirlink(dp, name, originip)
+#define vop_unlink(dp, name)                            vfs_unlink(dp, name)
+#define vop_rename(olddp, oldname, newdp, newname)      vfs_rename(olddp, oldname, newdp, newname)
 #define vop_dirlookup(dp, name, poff)                   (__vop_op(dp, dirlookup)(dp, name, poff))
 #define vop_ilock(ip)                                   (__vop_op(ip, ilock)(ip))
+#define vop_ilock_shared(ip)                            (__vop_op(ip, ilock_shared)(ip))
 #define vop_iunlock(ip)                                 (__vop_op(ip, iunlock)(ip))
 #define vop_iunlockput(ip)                              (__vop_op(ip, iunlockput)(ip))
 #define vop_iupdate(ip)                                 (__vop_op(ip, iupdate)(ip))
@@ -89,12 +120,14 @@ struct inode_ops {
 #define vop_isdirempty(dp)                              (__vop_op(ip, isdirempty)(dp))
 #define vop_link_inc(ip)                                (__vop_op(ip, link_inc)(ip))
 #define vop_link_dec(ip)                                (__vop_op(ip, link_dec)(ip))
-#define vop_create_inode(dirnode, type, major, minor, name)   (__vop_op(dirnode, create_inode)(dirnode, type, major, minor, name))
+#define vop_create_inode(dirnode, type, major, minor, name)   vfs_create_inode(dirnode, type, major, minor, name)
 #define vop_open(node, open_flags)                      (__vop_op(ip, open)(node, open_flags))
 #define vop_gettype(node)                               (__vop_op(node, gettype)(node))
 #define vop_getdev(node)                                (__vop_op(node, getdev)(node))
 #define vop_getnlink(node)                              (__vop_op(node, getnlink)(node))
 #define vop_getpath(node, path, maxlen)                 (__vop_op(node, getpath)(node, path, maxlen))
+#define vop_readdir(dp, dst, n, cookie)                 (__vop_op(dp, readdir)(dp, dst, n, cookie))
+#define vop_readahead(ip, off, n)                       (__vop_op(ip, readahead)(ip, off, n))
 
 #define vop_init(node, ops, fstype)            inode_init(node, ops, fstype)
 
@@ -0,0 +1,412 @@
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "stat.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "sfs.h"
+#include "fat32.h"
+#include "inode.h"
+#include "vfs.h"
+
+/* *
+ * Mount table.
+ *
+ * Each mounted volume has an entry naming its file system type and its
+ * device; the file system keeps its own state for the volume (struct
+ * sfs_fs, struct fat_fs), set up by fs_mount. A volume is reached by the
+ * name of its entry, as in "fat:/a", or through the directory it is
+ * mounted on: the entry holds a reference to that directory, whose
+ * in_mnt points back at the entry. A volume may also be mounted by
+ * name alone, as the boot volumes are. The first entry is the root
+ * file system, the one "/" refers to.
+ *
+ * A volume is named by its type, or by its type and device when
+ * another volume has that name already, as in "fat2".
+ *
+ * mtab.lock protects the entries and the in_mnt fields. Mounting and
+ * unmounting read and write the disk, so they are serialized by
+ * mtab.busy instead.
+ * */
+
+#define MNT_FREE                    0
+#define MNT_BUSY                    1   // being mounted or unmounted
+#define MNT_READY                   2
+
+struct fs_type {
+    const char *name;
+    int fstype;
+    int (*fs_mount)(uint dev);              // -1 if dev holds no such file system
+    void (*fs_unmount)(uint dev);
+    struct inode *(*fs_get_root)(uint dev);
+};
+
+struct vfs_mount {
+    int state;
+    char name[MNTNAMELEN];          // device name in "name:path"
+    const struct fs_type *type;
+    uint dev;
+    struct inode *covered;          // directory mounted on, or 0
+};
+
+static const struct fs_type fs_types[] = {
+    {"sfs", SFS_INODE, sfs_mount, sfs_unmount, sfs_get_root},
+    {"fat", FAT_INODE, fat_mount, fat_unmount, fat_get_root},
+};
+
+static struct {
+    struct spinlock lock;
+    int busy;                       // a mount or umount is in progress
+    struct vfs_mount mount[NMOUNT];
+} mtab;
+
+static const struct fs_type *
+fs_type_find(const char *name) {
+    int i;
+    for (i = 0; i < NELEM(fs_types); i ++) {
+        if (strncmp(fs_types[i].name, name, MNTNAMELEN) == 0) {
+            return &fs_types[i];
+        }
+    }
+    return 0;
+}
+
+// Device names are matched without regard to case.
+static int
+mount_namecmp(const char *s, const char *t) {
+    char a, b;
+    do {
+        a = *s ++, b = *t ++;
+        if (a >= 'A' && a <= 'Z') a += 'a' - 'A';
+        if (b >= 'A' && b <= 'Z') b += 'a' - 'A';
+    } while (a != '\0' && a == b);
+    return a - b;
+}
+
+// The entry for the volume holding node; caller holds mtab.lock.
+static struct vfs_mount *
+mount_find(struct inode *node) {
+    struct vfs_mount *m;
+    for (m = mtab.mount; m < mtab.mount + NMOUNT; m ++) {
+        if (m->state == MNT_READY && m->type->fstype == node->fstype && m->dev == node->in_dev) {
+            return m;
+        }
+    }
+    return 0;
+}
+
+static void
+mtab_begin(void) {
+    acquire(&mtab.lock);
+    while (mtab.busy) {
+        sleep(&mtab, &mtab.lock);
+    }
+    mtab.busy = 1;
+    release(&mtab.lock);
+}
+
+static void
+mtab_end(void) {
+    acquire(&mtab.lock);
+    mtab.busy = 0;
+    wakeup(&mtab);
+    release(&mtab.lock);
+}
+
+// The entry named name, or 0; caller holds mtab.lock.
+static struct vfs_mount *
+mount_byname(const char *name) {
+    struct vfs_mount *m;
+    for (m = mtab.mount; m < mtab.mount + NMOUNT; m ++) {
+        if (m->state != MNT_FREE && mount_namecmp(m->name, name) == 0) {
+            return m;
+        }
+    }
+    return 0;
+}
+
+// If path is just a volume name, "name:", copy the name into name,
+// which has room for MNTNAMELEN bytes, and return 1.
+static int
+mount_pathname(const char *path, char *name) {
+    int i;
+    for (i = 0; path[i] != ':'; i ++) {
+        if (path[i] == '\0' || path[i] == '/' || i == MNTNAMELEN - 1) {
+            return 0;
+        }
+    }
+    if (i == 0 || path[i + 1] != '\0') {
+        return 0;
+    }
+    memmove(name, path, i);
+    name[i] = '\0';
+    return 1;
+}
+
+static void
+mount_set(struct vfs_mount *m, const char *name, const struct fs_type *type, uint dev) {
+    safestrcpy(m->name, name, MNTNAMELEN);
+    m->type = type;
+    m->dev = dev;
+    m->covered = 0;
+}
+
+/* *
+ * vfs_init - enter the boot volumes: the root SFS as "sfs" and the FAT
+ * disk as "fat". Their state is loaded by vfs_mount_boot, which needs a
+ * process context; until then only their root inodes can be named.
+ * */
+void
+vfs_init(void) {
+    initlock(&mtab.lock, "mtab");
+    mount_set(&mtab.mount[0], "sfs", fs_type_find("sfs"), ROOTDEV);
+    mtab.mount[0].state = MNT_READY;
+    if (idepresent(FATDEV)) {
+        mount_set(&mtab.mount[1], "fat", fs_type_find("fat"), FATDEV);
+        mtab.mount[1].state = MNT_READY;
+    }
+}
+
+/* *
+ * vfs_mount_boot - load the boot volumes; called by the first process
+ * once the log has been recovered
+ * */
+void
+vfs_mount_boot(void) {
+    struct vfs_mount *m;
+    for (m = mtab.mount; m < mtab.mount + NMOUNT; m ++) {
+        if (m->state == MNT_READY && m->type->fs_mount(m->dev) != 0) {
+            if (m == mtab.mount) {
+                panic("vfs_mount_boot: bad root file system");
+            }
+            cprintf("%s: no %s file system on disk %d\n", m->name, m->type->name, m->dev);
+            m->state = MNT_FREE;
+        }
+    }
+}
+
+/* *
+ * vfs_get_root - get the root directory of the volume named devname
+ * */
+int
+vfs_get_root(const char *devname, struct inode **node_store) {
+    struct vfs_mount *m;
+    acquire(&mtab.lock);
+    for (m = mtab.mount; m < mtab.mount + NMOUNT; m ++) {
+        if (m->state == MNT_READY && mount_namecmp(m->name, devname) == 0) {
+            *node_store = m->type->fs_get_root(m->dev);
+            release(&mtab.lock);
+            return 0;
+        }
+    }
+    release(&mtab.lock);
+    return -1;
+}
+
+/* *
+ * vfs_get_bootfs - get the root directory of the root file system
+ * */
+int
+vfs_get_bootfs(struct inode **node_store) {
+    struct vfs_mount *m = mtab.mount;
+    *node_store = m->type->fs_get_root(m->dev);
+    return 0;
+}
+
+/* *
+ * vfs_cross - if a volume is mounted on directory node, return its root
+ * in place of node, whose reference is consumed
+ * */
+struct inode *
+vfs_cross(struct inode *node) {
+    struct inode *root;
+    struct vfs_mount *m;
+
+    if (node->in_mnt == 0) {
+        return node;
+    }
+    root = 0;
+    acquire(&mtab.lock);
+    if ((m = node->in_mnt) != 0) {
+        root = m->type->fs_get_root(m->dev);
+    }
+    release(&mtab.lock);
+    if (root == 0) {
+        return node;
+    }
+    vop_ref_dec(node);
+    return root;
+}
+
+/* *
+ * vfs_mountpoint - look up the volume holding node. Copy its name into
+ * name, which has room for MNTNAMELEN bytes, if name is not 0, and return
+ * a reference to the directory it is mounted on, or 0 if there is none.
+ * */
+struct inode *
+vfs_mountpoint(struct inode *node, char *name) {
+    struct vfs_mount *m;
+    struct inode *covered = 0;
+
+    acquire(&mtab.lock);
+    if ((m = mount_find(node)) != 0) {
+        if (name != 0) {
+            safestrcpy(name, m->name, MNTNAMELEN);
+        }
+        if (m->covered != 0) {
+            covered = vop_ref_inc(m->covered);
+        }
+    } else if (name != 0) {
+        *name = '\0';
+    }
+    release(&mtab.lock);
+    return covered;
+}
+
+/* *
+ * vfs_mount - mount the file system of type typename on device dev at
+ * directory path, or, if path is "name:", by that name alone with no
+ * directory covered. In the first case the volume is named by its type,
+ * or by its type and device if the type's name is taken, as in "fat2:".
+ * */
+int
+vfs_mount(uint dev, char *path, const char *typename) {
+    const struct fs_type *type;
+    struct vfs_mount *m, *mp;
+    struct inode *node;
+    char name[MNTNAMELEN];
+    int len;
+
+    if ((type = fs_type_find(typename)) == 0 || !idepresent(dev)) {
+        return -1;
+    }
+    node = 0;
+    if (!mount_pathname(path, name)) {
+        if ((node = vfs_lookup(path)) == 0) {
+            return -1;
+        }
+        vop_ilock(node);
+        // Mounting on the root of another volume would stack mounts.
+        if (vop_gettype(node) != T_DIR || vfs_isroot(node)) {
+            vop_iunlockput(node);
+            return -1;
+        }
+        vop_iunlock(node);
+    }
+
+    mtab_begin();
+    acquire(&mtab.lock);
+    m = 0;
+    for (mp = mtab.mount; mp < mtab.mount + NMOUNT; mp ++) {
+        if (mp->state == MNT_FREE) {
+            if (m == 0) {
+                m = mp;
+            }
+        } else if (mp->dev == dev) {
+            break;
+        }
+    }
+    if (node == 0) {
+        if (mount_byname(name) != 0) {
+            m = 0;
+        }
+    } else if (node->in_mnt != 0) {
+        m = 0;
+    } else {
+        safestrcpy(name, type->name, MNTNAMELEN - 1);
+        if (mount_byname(name) != 0) {
+            len = strlen(name);
+            name[len] = '0' + dev;
+            name[len + 1] = '\0';
+        }
+    }
+    if (mp < mtab.mount + NMOUNT || m == 0) {
+        release(&mtab.lock);
+        mtab_end();
+        if (node != 0) {
+            vop_ref_dec(node);
+        }
+        return -1;
+    }
+    // Claim the name along with the entry.
+    mount_set(m, name, type, dev);
+    m->state = MNT_BUSY;
+    release(&mtab.lock);
+
+    if (type->fs_mount(dev) != 0) {
+        acquire(&mtab.lock);
+        m->state = MNT_FREE;
+        release(&mtab.lock);
+        mtab_end();
+        if (node != 0) {
+            vop_ref_dec(node);
+        }
+        return -1;
+    }
+
+    acquire(&mtab.lock);
+    m->covered = node;
+    if (node != 0) {
+        node->in_mnt = m;
+    }
+    m->state = MNT_READY;
+    release(&mtab.lock);
+    mtab_end();
+    return 0;
+}
+
+/* *
+ * vfs_umount - unmount the volume whose root path names. Fails if any
+ * of its inodes is still in use, e.g. open or some process's cwd.
+ * */
+int
+vfs_umount(char *path) {
+    struct vfs_mount *m;
+    struct inode *node, *covered;
+    int fstype;
+    uint dev;
+
+    if ((node = vfs_lookup(path)) == 0) {
+        return -1;
+    }
+    mtab_begin();
+    acquire(&mtab.lock);
+    if ((m = mount_find(node)) == 0 || m == mtab.mount || !vfs_isroot(node)) {
+        release(&mtab.lock);
+        mtab_end();
+        vop_ref_dec(node);
+        return -1;
+    }
+    // Stop lookups from entering the volume.
+    m->state = MNT_BUSY;
+    if ((covered = m->covered) != 0) {
+        covered->in_mnt = 0;
+    }
+    release(&mtab.lock);
+    vop_ref_dec(node);
+
+    fstype = m->type->fstype;
+    dev = m->dev;
+    dcache_purge_fs(fstype, dev);
+    if (icache_busy(fstype, dev)) {
+        acquire(&mtab.lock);
+        if (covered != 0) {
+            covered->in_mnt = m;
+        }
+        m->state = MNT_READY;
+        release(&mtab.lock);
+        mtab_end();
+        return -1;
+    }
+    m->type->fs_unmount(dev);
+
+    acquire(&mtab.lock);
+    m->covered = 0;
+    m->state = MNT_FREE;
+    release(&mtab.lock);
+    mtab_end();
+    if (covered != 0) {
+        vop_ref_dec(covered);
+    }
+    return 0;
+}
@@ -0,0 +1,357 @@
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "stat.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "inode.h"
+#include "vfs.h"
+
+/* *
+ * Page cache for file data.
+ *
+ * Holds whole pages of regular files, indexed by (inode, page number
+ * in the file), so that reads copy from a page instead of going to the
+ * file system a sector at a time; metadata and directories stay in the
+ * buffer cache. As in the dentry cache, an inode is identified by its
+ * icache entry together with that entry's in_gen, so the pages of an
+ * inode that has left the icache can never match again and just age
+ * out. Entries are hashed by the gen they recorded, so that one can
+ * still be unhashed after its icache entry has been reused.
+ *
+ * Writes go to the file system first, through its log where it has
+ * one, and are then copied into any cached pages they cover: the
+ * cache never holds data that the file system does not. Only the part
+ * of a page below the end of file means anything. Files have no holes,
+ * so every byte there has been written since the file was last
+ * truncated, and so is current in the page too.
+ *
+ * An entry is busy while it is being filled; ref counts the callers
+ * copying to or from its page, who do so without pcache.lock, and the
+ * process mappings of the page. Only an entry that is neither can be
+ * recycled. A page that is mapped shared and writable may be stored to
+ * by the process; such pages are written back by munmap.
+ * */
+
+#define NPCACHE                     64
+#define NPHASH                      31
+
+struct cpage {
+    struct inode *node;             // 0 if the entry is unused
+    uint gen;                       // node->in_gen when filled
+    uint pgno;                      // page number in the file
+    int ref;
+    int busy;
+    int maps;                       // process mappings, counted in ref too
+    char *data;                     // the page, from kalloc
+    struct cpage *hnext;            // hash chain
+    struct cpage *prev;             // LRU list
+    struct cpage *next;
+};
+
+static struct {
+    struct spinlock lock;
+    struct cpage entry[NPCACHE];
+    struct cpage *hash[NPHASH];
+    // Linked list of all entries, through prev/next.
+    // head.next is most recently used.
+    struct cpage head;
+    int nmapped;                    // entries with maps > 0
+} pcache;
+
+void
+pcache_init(void) {
+    struct cpage *p;
+
+    initlock(&pcache.lock, "pcache");
+    pcache.head.prev = &pcache.head;
+    pcache.head.next = &pcache.head;
+    for (p = pcache.entry; p < pcache.entry + NPCACHE; p ++) {
+        p->next = pcache.head.next;
+        p->prev = &pcache.head;
+        pcache.head.next->prev = p;
+        pcache.head.next = p;
+    }
+}
+
+// As in the dentry cache, gen is passed separately so that an entry
+// whose inode has been freed and reused still hashes where it was put.
+static uint
+pcache_hash(struct inode *node, uint gen, uint pgno) {
+    return ((uint)node ^ gen ^ pgno * 31) % NPHASH;
+}
+
+static struct cpage *
+pcache_find(struct inode *node, uint pgno) {
+    struct cpage *p;
+    for (p = pcache.hash[pcache_hash(node, node->in_gen, pgno)]; p != 0; p = p->hnext) {
+        if (p->node == node && p->gen == node->in_gen && p->pgno == pgno) {
+            return p;
+        }
+    }
+    return 0;
+}
+
+// Move p to the front of the LRU list.
+static void
+pcache_touch(struct cpage *p) {
+    p->next->prev = p->prev;
+    p->prev->next = p->next;
+    p->next = pcache.head.next;
+    p->prev = &pcache.head;
+    pcache.head.next->prev = p;
+    pcache.head.next = p;
+}
+
+// Take p out of its hash chain and mark it unused.
+static void
+pcache_unhash(struct cpage *p) {
+    struct cpage **pp;
+
+    for (pp = &pcache.hash[pcache_hash(p->node, p->gen, p->pgno)]; *pp != p; pp = &(*pp)->hnext) {
+        if (*pp == 0) {
+            panic("pcache_unhash");
+        }
+    }
+    *pp = p->hnext;
+    p->node = 0;
+}
+
+/* *
+ * pcache_get - find page pgno of node, which the caller has locked, and
+ * hold it. If it is not cached, an entry is set up for it and *fill is set:
+ * the caller reads the page in and calls pcache_filled. Returns 0 if no
+ * entry is free, in which case the caller goes to the file system.
+ * */
+static struct cpage *
+pcache_get(struct inode *node, uint pgno, int *fill) {
+    struct cpage *p;
+    uint h;
+
+    acquire(&pcache.lock);
+again:
+    if ((p = pcache_find(node, pgno)) != 0) {
+        if (p->busy) {
+            sleep(p, &pcache.lock);
+            goto again;
+        }
+        p->ref ++;
+        pcache_touch(p);
+        release(&pcache.lock);
+        *fill = 0;
+        return p;
+    }
+    // Recycle the least recently used entry.
+    for (p = pcache.head.prev; p != &pcache.head; p = p->prev) {
+        if (p->ref == 0 && !p->busy) {
+            break;
+        }
+    }
+    if (p == &pcache.head) {
+        release(&pcache.lock);
+        return 0;
+    }
+    // Entries get their page on first use.
+    if (p->data == 0 && (p->data = kalloc()) == 0) {
+        release(&pcache.lock);
+        return 0;
+    }
+    if (p->node != 0) {
+        pcache_unhash(p);
+    }
+    p->node = node;
+    p->gen = node->in_gen;
+    p->pgno = pgno;
+    p->ref = 1;
+    p->busy = 1;
+    h = pcache_hash(node, node->in_gen, pgno);
+    p->hnext = pcache.hash[h];
+    pcache.hash[h] = p;
+    pcache_touch(p);
+    release(&pcache.lock);
+    *fill = 1;
+    return p;
+}
+
+// The page of p has been read in, or could not be if ok is 0.
+static void
+pcache_filled(struct cpage *p, int ok) {
+    acquire(&pcache.lock);
+    if (!ok) {
+        pcache_unhash(p);
+    }
+    p->busy = 0;
+    wakeup(p);
+    release(&pcache.lock);
+}
+
+static void
+pcache_put(struct cpage *p) {
+    acquire(&pcache.lock);
+    p->ref --;
+    release(&pcache.lock);
+}
+
+/* *
+ * pcache_hold - hold page pgno of node, which the caller has locked and which
+ * is size bytes long, reading it in if need be. Returns 0 if no entry is free
+ * or the page cannot be read.
+ * */
+static struct cpage *
+pcache_hold(struct inode *node, uint pgno, uint size) {
+    struct cpage *p;
+    uint len;
+    int fill;
+
+    if ((p = pcache_get(node, pgno, &fill)) == 0 || !fill) {
+        return p;
+    }
+    len = size - pgno * PGSIZE;
+    if (len > PGSIZE) {
+        len = PGSIZE;
+    }
+    if (__vop_op(node, read)(node, p->data, pgno * PGSIZE, len) != len) {
+        pcache_filled(p, 0);
+        pcache_put(p);
+        return 0;
+    }
+    pcache_filled(p, 1);
+    return p;
+}
+
+/* *
+ * pcache_read - read n bytes at off from regular file node, which the
+ * caller has locked, through the cache; as vop_read otherwise.
+ * */
+int
+pcache_read(struct inode *node, char *dst, uint off, uint n) {
+    struct stat st;
+    struct cpage *p;
+    uint tot, m, pgoff;
+
+    vop_fstat(node, &st);
+    if (off > st.size || off + n < off) {
+        return -1;
+    }
+    if (off + n > st.size) {
+        n = st.size - off;
+    }
+    for (tot = 0; tot < n; tot += m, off += m, dst += m) {
+        pgoff = off % PGSIZE;
+        m = n - tot < PGSIZE - pgoff ? n - tot : PGSIZE - pgoff;
+        if ((p = pcache_hold(node, off / PGSIZE, st.size)) == 0) {
+            if (__vop_op(node, read)(node, dst, off, m) != m) {
+                return -1;
+            }
+            continue;
+        }
+        memmove(dst, p->data + pgoff, m);
+        pcache_put(p);
+    }
+    return n;
+}
+
+/* *
+ * pcache_write - write n bytes at off to regular file node, which the
+ * caller has locked, and bring the cached pages they fall in up to date
+ * */
+int
+pcache_write(struct inode *node, char *src, uint off, uint n) {
+    struct cpage *p;
+    uint tot, m, pgoff;
+    int r;
+
+    if ((r = __vop_op(node, write)(node, src, off, n)) <= 0) {
+        return r;
+    }
+    for (tot = 0; tot < r; tot += m, off += m, src += m) {
+        pgoff = off % PGSIZE;
+        m = r - tot < PGSIZE - pgoff ? r - tot : PGSIZE - pgoff;
+        acquire(&pcache.lock);
+        if ((p = pcache_find(node, off / PGSIZE)) == 0) {
+            release(&pcache.lock);
+            continue;
+        }
+        // Readers are locked out by the inode lock, so the
+        // page cannot be being filled.
+        p->ref ++;
+        release(&pcache.lock);
+        memmove(p->data + pgoff, src, m);
+        pcache_put(p);
+    }
+    return r;
+}
+
+/* *
+ * pcache_map - hold page pgno of regular file node, which the caller has
+ * locked, for mapping into a process, with the part past the end of file
+ * zeroed. Returns the page, or 0 if the cache cannot spare one: at most
+ * half the entries may be mapped, so that reads and writes still find
+ * room, but a page that is mapped already can always be mapped again.
+ * A shared mapping, which must store to the cache's page and nowhere
+ * else, may take any entry that is free.
+ * */
+char *
+pcache_map(struct inode *node, uint pgno, int shared) {
+    struct stat st;
+    struct cpage *p;
+    uint len;
+
+    vop_fstat(node, &st);
+    if (pgno >= PGROUNDUP(st.size) / PGSIZE || (p = pcache_hold(node, pgno, st.size)) == 0) {
+        return 0;
+    }
+    acquire(&pcache.lock);
+    if (p->maps == 0) {
+        if (!shared && pcache.nmapped >= NPCACHE / 2) {
+            p->ref --;
+            release(&pcache.lock);
+            return 0;
+        }
+        pcache.nmapped ++;
+    }
+    p->maps ++;
+    release(&pcache.lock);
+    len = st.size - pgno * PGSIZE;
+    if (len < PGSIZE) {
+        memset(p->data + len, 0, PGSIZE - len);
+    }
+    return p->data;
+}
+
+static struct cpage *
+pcache_page(char *data) {
+    struct cpage *p;
+    for (p = pcache.entry; p < pcache.entry + NPCACHE; p ++) {
+        if (p->data == data) {
+            return p;
+        }
+    }
+    panic("pcache_page");
+}
+
+// Hold the mapped page data once more, for another mapping of it.
+void
+pcache_dup(char *data) {
+    struct cpage *p;
+
+    acquire(&pcache.lock);
+    p = pcache_page(data);
+    p->ref ++;
+    p->maps ++;
+    release(&pcache.lock);
+}
+
+// Release a mapping of page data.
+void
+pcache_unmap(char *data) {
+    struct cpage *p;
+
+    acquire(&pcache.lock);
+    p = pcache_page(data);
+    p->ref --;
+    if (-- p->maps == 0) {
+        pcache.nmapped --;
+    }
+    release(&pcache.lock);
+}
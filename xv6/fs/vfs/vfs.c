@@ -20,40 +20,20 @@ vfs_get_curdir(struct inode **dir_store){
     return 0;
 }
 
-int 
-vfs_get_root(const char *devname, struct inode **node_store) {
-    struct inode *rooti;
-	if(strncmp(devname, "sfs", 3)==0 || strncmp(devname, "SFS", 3)==0){
-        rooti = sfs_get_root();
-	}
-    else if(strncmp(devname, "fat", 3) == 0 || strncmp(devname, "FAT", 3)==0){
-        // cprintf("fat_get_root\n");
-        rooti = fat_get_root();
-    }
-    else{
-        rooti = sfs_get_root();
-    }
-    *node_store = rooti;
-    return 0;
-}
-
-int
-vfs_get_bootfs(struct inode **node_store) {
-    struct inode *rooti;
-    rooti = sfs_get_root();
-
-    *node_store = rooti;
-    return 0;
-}
-
 int
 namecmp(const char *s, const char *t)
 {
   return strncmp(s, t, DIRSIZ);
 }
 
+/* *
+ * get_device - find the directory path starts from, and the rest of path
+ * after any device name. path is only read: it may be a string in a
+ * process's read-only memory.
+ * */
 static int
 get_device(char *path, char **subpath, struct inode **node_store) {
+    char devname[MNTNAMELEN];
     int i, slash = -1, colon = -1;
     for (i = 0; path[i] != '\0'; i ++) {
         if (path[i] == ':') { colon = i; break; }
@@ -70,12 +50,16 @@ get_device(char *path, char **subpath, struct inode **node_store) {
     }
     if (colon > 0) {
         /* device:path - get root of device's filesystem */
-        path[colon] = '\0';
+        if (colon >= MNTNAMELEN) {
+            return -1;
+        }
+        memmove(devname, path, colon);
+        devname[colon] = '\0';
 
         /* device:/path - skip slash, treat as device:path */
         while (path[++ colon] == '/');
         *subpath = path + colon;
-        return vfs_get_root(path, node_store);
+        return vfs_get_root(devname, node_store);
     }
 
     int ret;
@@ -91,6 +75,101 @@ get_device(char *path, char **subpath, struct inode **node_store) {
     return 0;
 }
 
+// Longest name a directory of node's file system can hold.
+static int
+vfs_namemax(struct inode *node) {
+    return node->fstype == FAT_INODE ? FAT_DIRSIZ : DIRSIZ;
+}
+
+// Copy the next path element from path into name, which has room
+// for max+1 bytes; longer elements are truncated to max bytes.
+// Return a pointer to the element following the copied one, with
+// leading slashes skipped, or 0 if there is no element left.
+static char *
+vfs_skipelem(char *path, char *name, int max) {
+    char *s;
+    int len;
+
+    while (*path == '/') {
+        path ++;
+    }
+    if (*path == '\0') {
+        return 0;
+    }
+    s = path;
+    while (*path != '/' && *path != '\0') {
+        path ++;
+    }
+    len = path - s;
+    if (len > max) {
+        len = max;
+    }
+    memmove(name, s, len);
+    name[len] = '\0';
+    while (*path == '/') {
+        path ++;
+    }
+    return path;
+}
+
+/*
+ * vfs_walk - resolve path relative to node, consuming the reference to node.
+ * Each directory is locked shared while its element is looked up, first in
+ * the dentry cache and then in the file system; directories that have a volume
+ * mounted on them are replaced by the volume's root. If parent is set, stop one
+ * element early and copy the final element into name, which must have
+ * room for the file system's longest name.
+ */
+static struct inode*
+vfs_walk(struct inode *node, char *path, int parent, char *name) {
+    struct inode *next;
+    char elem[FAT_DIRSIZ + 1];
+    int max;
+
+    for (;;) {
+        max = vfs_namemax(node);
+        if ((path = vfs_skipelem(path, elem, max)) == 0) {
+            break;
+        }
+        if (strncmp(elem, "..", 3) == 0 && !(parent && *path == '\0') && vfs_isroot(node)
+            && (next = vfs_mountpoint(node, 0)) != 0) {
+            // ".." of a mounted volume's root is looked up in
+            // the directory the volume is mounted on.
+            vop_ref_dec(node);
+            node = next;
+        }
+        vop_ilock_shared(node);
+        if (vop_gettype(node) != T_DIR) {
+            vop_iunlockput(node);
+            return 0;
+        }
+        if (parent && *path == '\0') {
+            // Stop one level early.
+            memmove(name, elem, strlen(elem) < max ? strlen(elem) + 1 : max);
+            vop_iunlock(node);
+            return node;
+        }
+        if (strncmp(elem, ".", 2) == 0) {
+            vop_iunlock(node);
+            continue;
+        }
+        if (!dcache_lookup(node, elem, &next)) {
+            next = vop_dirlookup(node, elem, 0);
+            dcache_enter(node, elem, next);
+        }
+        vop_iunlockput(node);
+        if (next == 0) {
+            return 0;
+        }
+        node = vfs_cross(next);
+    }
+    if (parent) {
+        vop_ref_dec(node);
+        return 0;
+    }
+    return node;
+}
+
 /*
  * vfs_lookup - get the inode according to the path filename
  */
@@ -101,14 +180,7 @@ vfs_lookup(char *path) {
     if ((ret = get_device(path, &path, &node)) != 0) {
         return 0;
     }
-//    cprintf("vfs_lookup1 fstype = %d, path = %s\n", node->fstype, path);
-    if (*path != '\0') {
-        struct inode *result = vop_namei(node, path);
-//        cprintf("vfs_lookup getresult, path = %s\n", path);
-        return result;
-    }
- //   cprintf("vfs_lookup2 fstype = %d\n", node->fstype);
-    return node;
+    return vfs_walk(node, path, 0, 0);
 }
 
 /*
@@ -122,20 +194,234 @@ vfs_lookup_parent(char *path, char *name){
     if ((ret = get_device(path, &path, &node)) != 0) {
         return 0;
     }
- //   cprintf("vfs_lookup_parent fstype = %d\n", node->fstype);
-    return vop_nameiparent(node, path, name);
+    return vfs_walk(node, path, 1, name);
+}
+
+/*
+ * vfs_read - read from locked inode node; file data goes through the page cache
+ */
+int
+vfs_read(struct inode *node, char *dst, uint off, uint n) {
+    if (vop_gettype(node) == T_FILE) {
+        return pcache_read(node, dst, off, n);
+    }
+    return __vop_op(node, read)(node, dst, off, n);
+}
+
+/*
+ * vfs_write - write to locked inode node, keeping the page cache up to date
+ */
+int
+vfs_write(struct inode *node, char *src, uint off, uint n) {
+    if (vop_gettype(node) == T_FILE) {
+        return pcache_write(node, src, off, n);
+    }
+    return __vop_op(node, write)(node, src, off, n);
+}
+
+/*
+ * vfs_dirlink - add an entry to locked directory dp; a name that was
+ * cached as absent may now exist
+ */
+int
+vfs_dirlink(struct inode *dp, char *name, struct inode *node) {
+    dcache_purge(dp, 1);
+    return __vop_op(dp, dirlink)(dp, name, node);
+}
+
+/*
+ * vfs_create_inode - create a new inode named name in locked directory dirnode
+ */
+struct inode*
+vfs_create_inode(struct inode *dirnode, short type, short major, short minor, char *name) {
+    dcache_purge(dirnode, 1);
+    return __vop_op(dirnode, create_inode)(dirnode, type, major, minor, name);
+}
+
+/*
+ * vfs_unlink - remove name from directory dp, consuming the reference to dp.
+ * Cached entries of dp are dropped afterwards: the file system may know the
+ * removed inode by other names (e.g. FAT short names) as well.
+ */
+int
+vfs_unlink(struct inode *dp, char *name) {
+    int ret;
+    vop_ref_inc(dp);
+    ret = __vop_op(dp, unlink)(dp, name);
+    dcache_purge(dp, 0);
+    vop_ref_dec(dp);
+    return ret;
+}
+
+/*
+ * vfs_rename - move the entry oldname in directory olddp to newname in
+ * directory newdp, which must be on the same volume; neither is locked.
+ * The old name's cached entries go, and the new name may now exist.
+ */
+int
+vfs_rename(struct inode *olddp, char *oldname, struct inode *newdp, char *newname) {
+    int ret;
+    if (olddp->fstype != newdp->fstype || olddp->in_dev != newdp->in_dev) {
+        return -1;
+    }
+    ret = __vop_op(olddp, rename)(olddp, oldname, newdp, newname);
+    dcache_purge(olddp, 0);
+    dcache_purge(newdp, 1);
+    return ret;
+}
+
+/*
+ * vfs_isroot - is node the root directory of its file system?
+ */
+int
+vfs_isroot(struct inode *node) {
+    switch (node->fstype) {
+    case SFS_INODE:
+        return node->in_inum == ROOTINO;
+    case FAT_INODE:
+        return node->in_inum == 2;
+    }
+    return 0;
+}
+
+/*
+ * vfs_dirent - fill in a struct dirent at dst, which has room for n bytes,
+ * for vop_readdir; off is the cookie for the entries after this one.
+ * Returns the length of the record, or 0 if it does not fit.
+ */
+int
+vfs_dirent(char *dst, uint n, uint ino, uint off, short type, const char *name, int namlen) {
+    struct dirent *d = (struct dirent *)dst;
+    uint reclen = DIRENT_RECLEN(namlen);
+
+    if (reclen > n) {
+        return 0;
+    }
+    d->ino = ino;
+    d->off = off;
+    d->reclen = reclen;
+    d->namlen = namlen;
+    d->type = type;
+    memmove(d->name, name, namlen);
+    d->name[namlen] = '\0';
+    return reclen;
+}
+
+/*
+ * vfs_copy_range - copy n bytes of file src from offset soff to file dst at
+ * offset doff, or as many as src has; neither is locked and no transaction
+ * is open. The data moves through a page from kalloc, with one transaction
+ * per page written so that a large copy does not overflow the log, and the
+ * source's next page is read ahead while the current one is written.
+ * Returns the number of bytes copied, or -1 if none could be.
+ */
+int
+vfs_copy_range(struct inode *src, uint soff, struct inode *dst, uint doff, uint n) {
+    char *page;
+    uint tot, chunk;
+    int r, w;
+
+    if ((page = kalloc()) == 0) {
+        return -1;
+    }
+    // As in filewrite: room in the log for the data, the inode, the
+    // block map and two sectors of slop for unaligned writes.
+    chunk = ((LOGSIZE-1-1-2) / 2) * 512;
+    if (chunk > PGSIZE) {
+        chunk = PGSIZE;
+    }
+    r = 0;
+    for (tot = 0; tot < n; tot += w) {
+        r = n - tot < chunk ? n - tot : chunk;
+        vop_ilock_shared(src);
+        if ((r = vop_read(src, page, soff + tot, r)) > 0 && tot + r < n) {
+            vop_readahead(src, soff + tot + r, n - tot - r < chunk ? n - tot - r : chunk);
+        }
+        vop_iunlock(src);
+        if (r <= 0) {
+            break;
+        }
+        begin_trans();
+        vop_ilock(dst);
+        w = vop_write(dst, page, doff + tot, r);
+        vop_iunlock(dst);
+        commit_trans();
+        if (w != r) {
+            if (w > 0) {
+                tot += w;
+            }
+            break;
+        }
+    }
+    kfree(page);
+    return tot > 0 || r == 0 ? tot : -1;
+}
+
+/*
+ * vfs_fspath - place the path of directory node within its file system so
+ * that it ends at path[pos], as dcache_getpath does, consuming the reference
+ * to node. The file system works it out from disk if the dentry cache can't.
+ */
+static int
+vfs_fspath(struct inode *node, char *path, int pos) {
+    int ret, len;
+    char *p;
+
+    if ((ret = dcache_getpath(node, path, pos)) >= 0) {
+        vop_ref_dec(node);
+        return ret;
+    }
+    // vop_getpath consumes the reference; it fills the front
+    // of path with "<fs>:/" followed by the elements.
+    if (vop_getpath(node, path, pos) != 0) {
+        return -1;
+    }
+    for (p = path; *p != ':'; p ++) {
+        if (*p == '\0') {
+            return -1;
+        }
+    }
+    p += 2;
+    len = strlen(p);
+    memmove(path + pos - len, p, len);
+    return pos - len;
 }
 
 /*
  * vfs_getcwd - retrieve current working directory(cwd).
+ * The path is assembled volume by volume up to the root file system,
+ * and is prefixed with the name of the volume it ends on, e.g. "sfs:/".
  */
 int
 vfs_getcwd(char *path, int len) {
-    int ret;
-    struct inode *node;
+    int ret, pos, n;
+    struct inode *node, *covered;
+    char name[MNTNAMELEN];
+
+    if (len <= 0) {
+        return -1;
+    }
     if ((ret = vfs_get_curdir(&node)) != 0) {
         return ret;
     }
-    ret = vop_getpath(node, path, len);
-    return ret;
-}
\ No newline at end of file
+    pos = len - 1;
+    path[pos] = '\0';
+    do {
+        covered = vfs_mountpoint(node, name);
+        if ((pos = vfs_fspath(node, path, pos)) < 0) {
+            if (covered != 0) {
+                vop_ref_dec(covered);
+            }
+            return -1;
+        }
+    } while ((node = covered) != 0);
+    n = strlen(name);
+    if (n + 2 > pos) {
+        return -1;
+    }
+    memmove(path + n + 2, path + pos, len - pos);
+    memmove(path, name, n);
+    path[n] = ':';
+    path[n + 1] = '/';
+    return 0;
+}
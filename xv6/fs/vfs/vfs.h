@@ -1,12 +1,32 @@
 
 struct inode;
+struct findcursor;
 
 
 
+#define MNTNAMELEN                  8   // longest volume name, with the NUL
+
 int vfs_get_root(const char *devname, struct inode **node_store);
+int vfs_get_bootfs(struct inode **node_store);
+int vfs_mount(uint dev, char *path, const char *typename);
+int vfs_umount(char *path);
+struct inode *vfs_cross(struct inode *node);
+struct inode *vfs_mountpoint(struct inode *node, char *name);
 int vfs_get_curdir(struct inode **dir_store);
 struct inode* vfs_lookup(char *path);
 struct inode* vfs_lookup_parent(char *path, char *name);
 int vfs_getcwd(char *path, int len);
+int vfs_find(char *path, const char *pat, int type, char *buf, int n, struct findcursor *cur);
+int vfs_copy_range(struct inode *src, uint soff, struct inode *dst, uint doff, uint n);
 
 int namecmp(const char *s, const char *t);
+
+int dcache_lookup(struct inode *dp, const char *name, struct inode **node_store);
+void dcache_enter(struct inode *dp, const char *name, struct inode *node);
+void dcache_purge(struct inode *dp, int negative_only);
+void dcache_purge_fs(int fstype, uint dev);
+int dcache_getpath(struct inode *node, char *path, int pos);
+int pcache_read(struct inode *node, char *dst, uint off, uint n);
+int pcache_write(struct inode *node, char *src, uint off, uint n);
+int vfs_isroot(struct inode *node);
+int vfs_dirent(char *dst, uint n, uint ino, uint off, short type, const char *name, int namlen);
@@ -2,36 +2,60 @@
 
 #include "types.h"
 #include "stat.h"
+#include "fcntl.h"
 #include "user.h"
 
-char buf[1024];
+#define WINDOW (16*4096)  // bytes mapped at a time
+
+char buf[1024];  // the line being put together
+int m;           // its length
+char in[512];
 int match(char*, char*);
 
+// Take the n bytes at p as the next input, matching each line
+// as it is completed.
+void
+scan(char *pattern, char *p, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    if(p[i] != '\n'){
+      if(m < sizeof(buf) - 1)
+        buf[m++] = p[i];
+      continue;
+    }
+    buf[m] = 0;
+    if(match(pattern, buf)){
+      buf[m] = '\n';
+      write(1, buf, m+1);
+    }
+    m = 0;
+  }
+}
+
 void
 grep(char *pattern, int fd)
 {
-  int n, m;
-  char *p, *q;
-  
+  struct stat st;
+  char *p;
+  int n, off;
+
   m = 0;
-  while((n = read(fd, buf+m, sizeof(buf)-m)) > 0){
-    m += n;
-    p = buf;
-    while((q = strchr(p, '\n')) != 0){
-      *q = 0;
-      if(match(pattern, p)){
-        *q = '\n';
-        write(1, p, q+1 - p);
-      }
-      p = q+1;
-    }
-    if(p == buf)
-      m = 0;
-    if(m > 0){
-      m -= p - buf;
-      memmove(buf, p, m);
+  // Files are mapped a window at a time and scanned in place;
+  // anything that cannot be mapped is read.
+  if(fstat(fd, &st) == 0 && st.type == T_FILE){
+    for(off = 0; off < st.size; off += n){
+      n = st.size - off < WINDOW ? st.size - off : WINDOW;
+      if((p = mmap(0, n, PROT_READ, MAP_PRIVATE, fd, off)) == MAP_FAILED)
+        break;
+      scan(pattern, p, n);
+      munmap(p, n);
     }
+    lseek(fd, off, SEEK_SET);
   }
+  while((n = read(fd, in, sizeof(in))) > 0)
+    scan(pattern, in, n);
 }
 
 int
@@ -54,8 +54,9 @@ static struct {
 static struct spinlock idelock;
 static struct buf *idequeue;
 
-static int havedisk1;
-static int havedisk2;
+#define NIDE                    4  // two drives on each of two channels
+
+static int havedisk[NIDE];
 static void idestart(struct buf*);
 
 // Wait for IDE disk to become ready.
@@ -77,7 +78,7 @@ idewait(ushort iobase, int checkerr)
 void
 ideinit(void)
 {
-  int i;
+  int i, d;
 
   initlock(&idelock, "ide");
   picenable(IRQ_IDE0);
@@ -85,22 +86,16 @@ ideinit(void)
   ioapicenable(IRQ_IDE0, ncpu - 1);
   ioapicenable(IRQ_IDE1, ncpu - 1);
 
-  idewait(IO_BASE0, 0);
-  // Check if disk 1 is present
-  outb(IO_BASE0 + ISA_SDH, 0xe0 | (1<<4));
-  for(i=0; i<1000; i++){
-    if(inb(IO_BASE0 + ISA_COMMAND) != 0){
-      havedisk1 = 1;
-      break;
-    }
-  }
-  
-  idewait(IO_BASE1, 0);
-  outb(IO_BASE1 + ISA_SDH, 0xe0 | (0<<4));
-  for(i=0; i<1000; i++){
-    if(inb(IO_BASE1 + ISA_COMMAND) != 0){
-      havedisk2 = 1;
-      break;
+  // Disk 0 holds the kernel; check which of the others are present.
+  havedisk[0] = 1;
+  for(d=1; d<NIDE; d++){
+    idewait(IO_BASE(d), 0);
+    outb(IO_BASE(d) + ISA_SDH, 0xe0 | ((d&1)<<4));
+    for(i=0; i<1000; i++){
+      if(inb(IO_BASE(d) + ISA_COMMAND) != 0){
+        havedisk[d] = 1;
+        break;
+      }
     }
   }
   // Switch back to disk 0.
@@ -167,12 +162,26 @@ ideintr(void)
     idestart(idequeue);
 
   release(&idelock);
+
+  // Nobody waits for a read-ahead; give its buffer back.
+  if(b->flags & B_ASYNC){
+    b->flags &= ~B_ASYNC;
+    brelse(b);
+  }
+}
+
+// Is there a disk for device dev?
+int
+idepresent(uint dev)
+{
+  return dev < NIDE && havedisk[dev];
 }
 
 //PAGEBREAK!
 // Sync buf with disk. 
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
 // Else if B_VALID is not set, read buf from disk, set B_VALID.
+// A read-ahead (B_ASYNC) is only queued; ideintr releases the buf.
 void
 iderw(struct buf *b)
 {
@@ -182,10 +191,8 @@ iderw(struct buf *b)
     panic("iderw: buf not busy");
   if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
     panic("iderw: nothing to do");
-  if(b->dev != 0 && !havedisk1)
-    panic("iderw: ide disk 1 not present");
-  if(b->dev != 0 && !havedisk2)
-    panic("iderw: ide disk 2 not present");
+  if(!idepresent(b->dev))
+    panic("iderw: ide disk not present");
   acquire(&idelock);  //DOC:acquire-lock
   // Append b to idequeue.
   b->qnext = 0;
@@ -197,7 +204,11 @@ iderw(struct buf *b)
   if(idequeue == b)
     idestart(b);
 //  cprintf("after idestart iderw dev = %d, flags=%d, data=%d\n", b->dev, b->flags, b->data[0]);
-  // Wait for request to finish.
+  // Wait for request to finish, unless it is a read-ahead.
+  if(b->flags & B_ASYNC){
+    release(&idelock);
+    return;
+  }
   while((b->flags & (B_VALID|B_DIRTY)) != B_VALID){
     sleep(b, &idelock);
 //    cprintf("b->flag=%d\n",b->flags);
@@ -1,6 +1,7 @@
 // Physical memory allocator, intended to allocate
 // memory for user processes, kernel stacks, page table pages,
-// and pipe buffers. Allocates 4096-byte pages.
+// and pipe buffers. Allocates 4096-byte pages, and blocks of
+// 2^order contiguous pages from a buddy system beneath.
 
 #include "types.h"
 #include "defs.h"
@@ -8,18 +9,53 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "spinlock.h"
+#include "proc.h"
+#include "x86.h"
 
 void freerange(void *vstart, void *vend);
 extern char end[]; // first address after kernel loaded from ELF file
 
 struct run {
   struct run *next;
+  struct run *prev;  // on the buddy lists only
+};
+
+#define NZERO   64  // zeroed pages kept for kzalloc
+#define KCPUMAX 64  // most free pages a CPU keeps to itself
+#define KBATCH  16  // pages moved between a CPU and kmem at once
+#define NPAGE   (PHYSTOP/PGSIZE)
+#define BFREE   0x80  // in kmem.order: heads a free block
+
+// Each CPU keeps free pages of its own, so that most
+// allocations and frees take only its lock. A CPU with too
+// many gives a batch back to the buddy lists; one that runs out
+// takes a batch from there, or else from the other CPUs.
+struct kcpu {
+  struct spinlock lock;
+  struct run *freelist;
+  int nfree;
+  uint nalloc;           // pages allocated on this CPU
+  uint nfreed;           // pages freed on this CPU
 };
 
 struct {
   struct spinlock lock;
   int use_lock;
-  struct run *freelist;
+  // Free blocks of 2^k pages, aligned to their size, on
+  // free[k]. Freeing a block merges it with its buddy, the
+  // other half of the block of twice the size, when that
+  // is free too.
+  struct run *free[MAXORDER+1];
+  uchar order[NPAGE];    // BFREE|k for the first page of a free block
+  int nfree;             // pages in the blocks on free[]
+  struct run *zerolist;  // zeroed but for the link
+  int nzero;             // pages on zerolist or on their way
+  uint nlock;            // acquisitions of lock
+  uint ncontended;       // ... that found it held
+  struct kcpu cpu[NCPU];
+  // References to each physical page from kalloc; more than
+  // one while processes share it copy-on-write.
+  int ref[NPAGE];
 } kmem;
 
 // Initialization happens in two phases.
@@ -27,10 +63,16 @@ struct {
 // the pages mapped by entrypgdir on free list.
 // 2. main() calls kinit2() with the rest of the physical pages
 // after installing a full page table that maps them on all cores.
+// Until then there is one CPU and no per-CPU state: pages go
+// straight to the buddy lists.
 void
 kinit1(void *vstart, void *vend)
 {
+  int i;
+
   initlock(&kmem.lock, "kmem");
+  for(i = 0; i < NCPU; i++)
+    initlock(&kmem.cpu[i].lock, "kcpu");
   kmem.use_lock = 0;
   freerange(vstart, vend);
 }
@@ -51,29 +93,207 @@ freerange(void *vstart, void *vend)
     kfree(p);
 }
 
+static void
+kmemlock(void)
+{
+  int held;
+
+  if(!kmem.use_lock)
+    return;
+  held = kmem.lock.locked;  // racy, but only counted
+  acquire(&kmem.lock);
+  kmem.nlock++;
+  if(held)
+    kmem.ncontended++;
+}
+
+static void
+kmemunlock(void)
+{
+  if(kmem.use_lock)
+    release(&kmem.lock);
+}
+
+// Buddy lists, under kmem.lock. Page numbers are physical.
+static void
+bpush(uint pn, int k)
+{
+  struct run *r;
+
+  r = p2v(pn * PGSIZE);
+  r->prev = 0;
+  r->next = kmem.free[k];
+  if(r->next)
+    r->next->prev = r;
+  kmem.free[k] = r;
+  kmem.order[pn] = BFREE | k;
+  kmem.nfree += 1 << k;
+}
+
+static void
+bunlink(uint pn, int k)
+{
+  struct run *r;
+
+  r = p2v(pn * PGSIZE);
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.free[k] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.order[pn] = 0;
+  kmem.nfree -= 1 << k;
+}
+
+// Free the block of 2^k pages at page pn.
+static void
+bfree(uint pn, int k)
+{
+  uint b;
+
+  for(; k < MAXORDER; k++){
+    b = pn ^ (1 << k);
+    if(b >= NPAGE || kmem.order[b] != (BFREE | k))
+      break;
+    bunlink(b, k);
+    pn &= ~(1 << k);
+  }
+  bpush(pn, k);
+}
+
+// Allocate a block of 2^k pages, splitting a larger one if need be.
+static struct run*
+balloc(int k)
+{
+  struct run *r;
+  uint pn;
+  int j;
+
+  for(j = k; j <= MAXORDER && kmem.free[j] == 0; j++)
+    ;
+  if(j > MAXORDER)
+    return 0;
+  r = kmem.free[j];
+  pn = v2p(r) / PGSIZE;
+  bunlink(pn, j);
+  // Give back the upper halves.
+  while(j > k){
+    j--;
+    bpush(pn + (1 << j), j);
+  }
+  return r;
+}
+
+// Return the pages of list to the buddy lists.
+static void
+kdrain(struct run *list)
+{
+  struct run *r;
+
+  kmemlock();
+  while((r = list) != 0){
+    list = r->next;
+    bfree(v2p(r) / PGSIZE, 0);
+  }
+  kmemunlock();
+}
+
+// Take up to n pages off *list; return them, ending at *last.
+static struct run*
+ktake(struct run **list, int n, struct run **last, int *got)
+{
+  struct run *r, *first;
+
+  first = *list;
+  *got = 0;
+  for(r = 0; *list && *got < n; (*got)++){
+    r = *list;
+    *list = r->next;
+  }
+  if(r)
+    r->next = 0;
+  *last = r;
+  return *got ? first : 0;
+}
+
+// Find a batch of free pages for CPU c, which has none: from
+// the buddy lists, or failing that half of another CPU's.
+static struct run*
+krefill(struct kcpu *c, struct run **last, int *got)
+{
+  struct kcpu *o;
+  struct run *r, *list;
+
+  list = *last = 0;
+  kmemlock();
+  for(*got = 0; *got < KBATCH && (r = balloc(0)) != 0; (*got)++){
+    r->next = list;
+    list = r;
+    if(*last == 0)
+      *last = r;
+  }
+  kmemunlock();
+  for(o = kmem.cpu; list == 0 && o < &kmem.cpu[NCPU]; o++){
+    if(o == c || o->freelist == 0)
+      continue;
+    acquire(&o->lock);
+    list = ktake(&o->freelist, (o->nfree + 1) / 2, last, got);
+    o->nfree -= *got;
+    release(&o->lock);
+  }
+  return list;
+}
+
 //PAGEBREAK: 21
-// Free the page of physical memory pointed at by v,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+// Drop a reference to the page of physical memory pointed at
+// by v, which normally should have been returned by a call
+// to kalloc(), and free it if that was the last.  (The
+// exception is when initializing the allocator; see kinit
+// above.)
 void
 kfree(char *v)
 {
-  struct run *r;
+  struct run *r, *list, *last;
+  struct kcpu *c;
+  int n;
 
   if((uint)v % PGSIZE || v < end || v2p(v) >= PHYSTOP)
     panic("kfree");
 
+  if(xadd(&kmem.ref[v2p(v) / PGSIZE], -1) > 1)
+    return;
+  kmem.ref[v2p(v) / PGSIZE] = 0;
+
+#if KDEBUG
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
+#endif
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
   r = (struct run*)v;
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  if(kmem.use_lock)
-    release(&kmem.lock);
+  if(!kmem.use_lock){
+    kmemlock();
+    bfree(v2p(v) / PGSIZE, 0);
+    kmemunlock();
+    return;
+  }
+
+  pushcli();
+  c = &kmem.cpu[cpu->id];
+  acquire(&c->lock);
+  r->next = c->freelist;
+  c->freelist = r;
+  c->nfree++;
+  c->nfreed++;
+  list = 0;
+  if(c->nfree > KCPUMAX){
+    list = ktake(&c->freelist, KBATCH, &last, &n);
+    c->nfree -= n;
+  }
+  release(&c->lock);
+  popcli();
+  if(list)
+    kdrain(list);
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -82,15 +302,209 @@ kfree(char *v)
 char*
 kalloc(void)
 {
-  struct run *r;
+  struct run *r, *list, *last;
+  struct kcpu *c;
+  int n;
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
-  r = kmem.freelist;
+  r = 0;
+  if(kmem.use_lock){
+    pushcli();
+    c = &kmem.cpu[cpu->id];
+    acquire(&c->lock);
+    if((r = c->freelist) == 0){
+      release(&c->lock);
+      list = krefill(c, &last, &n);
+      acquire(&c->lock);
+      if(list){
+        last->next = c->freelist;
+        c->freelist = list;
+        c->nfree += n;
+      }
+    }
+    if((r = c->freelist) != 0){
+      c->freelist = r->next;
+      c->nfree--;
+      c->nalloc++;
+    }
+    release(&c->lock);
+    popcli();
+  }
+  if(r == 0){
+    // Before kinit2, or the last of memory: the buddy
+    // lists, then the zeroed pages.
+    kmemlock();
+    if((r = balloc(0)) == 0 && (r = kmem.zerolist) != 0){
+      kmem.zerolist = r->next;
+      kmem.nzero--;
+    }
+    kmemunlock();
+  }
   if(r)
-    kmem.freelist = r->next;
-  if(kmem.use_lock)
-    release(&kmem.lock);
+    kmem.ref[v2p(r) / PGSIZE] = 1;
+  return (char*)r;
+}
+
+// Allocate 2^order contiguous pages, aligned to their size.
+// Order 0 is kalloc.
+char*
+kallocpages(int order)
+{
+  struct run *r, *list;
+  struct kcpu *c;
+
+  if(order == 0)
+    return kalloc();
+  if(order < 0 || order > MAXORDER)
+    return 0;
+  kmemlock();
+  r = balloc(order);
+  kmemunlock();
+  if(r == 0 && kmem.use_lock){
+    // The pages the CPUs hold may be what the buddy
+    // lists lack to make up a block.
+    for(c = kmem.cpu; c < &kmem.cpu[NCPU]; c++){
+      acquire(&c->lock);
+      list = c->freelist;
+      c->freelist = 0;
+      c->nfree = 0;
+      release(&c->lock);
+      kdrain(list);
+    }
+    kmemlock();
+    r = balloc(order);
+    kmemunlock();
+  }
+  if(r)
+    kmem.ref[v2p(r) / PGSIZE] = 1;
+  return (char*)r;
+}
+
+// Free the 2^order pages at v, from kallocpages.
+void
+kfreepages(char *v, int order)
+{
+  if(order == 0){
+    kfree(v);
+    return;
+  }
+  if((uint)v % (PGSIZE << order) || v < end || v2p(v) + (PGSIZE << order) > PHYSTOP)
+    panic("kfreepages");
+  kmem.ref[v2p(v) / PGSIZE] = 0;
+#if KDEBUG
+  memset(v, 1, PGSIZE << order);
+#endif
+  kmemlock();
+  bfree(v2p(v) / PGSIZE, order);
+  kmemunlock();
+}
+
+// Zero a page for the kzalloc pool if it is short. The
+// scheduler calls this when its CPU has nothing to run, so
+// that page faults and page table allocation find the work
+// done.
+void
+kzeroidle(void)
+{
+  struct run *r;
+
+  // Other CPUs reach the scheduler before kinit2 is done.
+  if(!kmem.use_lock || kmem.nzero >= NZERO)
+    return;
+  kmemlock();
+  if(kmem.nzero >= NZERO){
+    kmemunlock();
+    return;
+  }
+  kmem.nzero++;
+  kmemunlock();
+
+  if((r = (struct run*)kalloc()) != 0){
+    memset(r, 0, PGSIZE);
+    kmem.ref[v2p(r) / PGSIZE] = 0;
+  }
+  kmemlock();
+  if(r){
+    r->next = kmem.zerolist;
+    kmem.zerolist = r;
+  } else
+    kmem.nzero--;
+  kmemunlock();
+}
+
+// Allocate a zeroed page, from the pool kzeroidle keeps if it can.
+char*
+kzalloc(void)
+{
+  struct run *r;
+
+  r = 0;
+  if(kmem.zerolist){
+    kmemlock();
+    if((r = kmem.zerolist) != 0){
+      kmem.zerolist = r->next;
+      kmem.nzero--;
+    }
+    kmemunlock();
+  }
+  if(r){
+    r->next = 0;
+    kmem.ref[v2p(r) / PGSIZE] = 1;
+    return (char*)r;
+  }
+  if((r = (struct run*)kalloc()) != 0)
+    memset(r, 0, PGSIZE);
   return (char*)r;
 }
 
+// Return the number of free pages, zeroed ones included.
+// No lock: the answer may be stale by the time it is used.
+int
+kfreecount(void)
+{
+  struct kcpu *c;
+  int n;
+
+  n = kmem.nfree + kmem.nzero;
+  for(c = kmem.cpu; c < &kmem.cpu[ncpu]; c++)
+    n += c->nfree;
+  return n;
+}
+
+// Take another reference to the page at v, from kalloc.
+void
+kdup(char *v)
+{
+  xadd(&kmem.ref[v2p(v) / PGSIZE], 1);
+}
+
+// Return the number of references to the page at v.
+int
+krefs(char *v)
+{
+  return kmem.ref[v2p(v) / PGSIZE];
+}
+
+// Print the allocator's counters to the console. For ^P.
+// No lock, as for procdump.
+void
+kallocdump(void)
+{
+  struct kcpu *c;
+  struct run *r;
+  int n;
+
+  int k;
+
+  cprintf("kmem: lock %d contended %d free %d zeroed %d free blocks",
+          kmem.nlock, kmem.ncontended, kfreecount(), kmem.nzero);
+  for(k = 0; k <= MAXORDER; k++){
+    n = 0;
+    for(r = kmem.free[k]; r; r = r->next)
+      n++;
+    cprintf(" %d", n);
+  }
+  cprintf("\n");
+  for(c = kmem.cpu; c < &kmem.cpu[ncpu]; c++)
+    cprintf("cpu%d: alloc %d free %d cached %d\n",
+            c - kmem.cpu, c->nalloc, c->nfreed, c->nfree);
+}
@@ -24,8 +24,10 @@
 // buffer locks prevent read-only calls from seeing inconsistent data.
 //
 // The log is a physical re-do log containing disk blocks.
+// It lives on the root device but also carries the blocks of
+// SFS volumes mounted from other devices.
 // The on-disk log format:
-//   header block, containing sector #s for block A, B, C, ...
+//   header block, containing device and sector #s for block A, B, C, ...
 //   block A
 //   block B
 //   block C
@@ -37,6 +39,7 @@
 struct logheader {
   int n;   
   int sector[LOGSIZE];
+  int dev[LOGSIZE];
 };
 
 struct log {
@@ -58,10 +61,15 @@ initlog(void)
     panic("initlog: too big logheader");
 
   struct sfs_super sb;
+  int spb;
   initlock(&log.lock, "log");
+  // Read the super block directly: the in-memory SFS state
+  // must not be set up until the log has been recovered.
   readsb(ROOTDEV, &sb);
-  log.start = sb.size - sb.nlog;
-  log.size = sb.nlog;
+  spb = sb.bsize / BSIZE;
+  // The log is addressed by sector, like the rest of the metadata.
+  log.start = (sb.size - sb.nlog) * spb;
+  log.size = sb.nlog * spb;
   log.dev = ROOTDEV;
   recover_from_log();
 }
@@ -74,7 +82,7 @@ install_trans(void)
 
   for (tail = 0; tail < log.lh.n; tail++) {
     struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.sector[tail]); // read dst
+    struct buf *dbuf = bread(log.lh.dev[tail], log.lh.sector[tail]); // read dst
     memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
     bwrite(dbuf);  // write dst to disk
     brelse(lbuf); 
@@ -92,6 +100,7 @@ read_head(void)
   log.lh.n = lh->n;
   for (i = 0; i < log.lh.n; i++) {
     log.lh.sector[i] = lh->sector[i];
+    log.lh.dev[i] = lh->dev[i];
   }
   brelse(buf);
 }
@@ -108,6 +117,7 @@ write_head(void)
   hb->n = log.lh.n;
   for (i = 0; i < log.lh.n; i++) {
     hb->sector[i] = log.lh.sector[i];
+    hb->dev[i] = log.lh.dev[i];
   }
   bwrite(buf);
   brelse(buf);
@@ -168,11 +178,12 @@ log_write(struct buf *b)
     panic("write outside of trans");
 
   for (i = 0; i < log.lh.n; i++) {
-    if (log.lh.sector[i] == b->sector)   // log absorbtion?
+    if (log.lh.sector[i] == b->sector && log.lh.dev[i] == b->dev)   // log absorbtion?
       break;
   }
   log.lh.sector[i] = b->sector;
-  struct buf *lbuf = bread(b->dev, log.start+i+1);
+  log.lh.dev[i] = b->dev;
+  struct buf *lbuf = bread(log.dev, log.start+i+1);
   memmove(lbuf->data, b->data, BSIZE);
   bwrite(lbuf);
   brelse(lbuf);
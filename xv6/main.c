@@ -31,9 +31,14 @@ main(void)
   tvinit();        // trap vectors
   binit();         // buffer cache
   fileinit();      // file table
-  sfs_iinit();     // inode cache
+  pipeinit();      // pipes
+  icache_init();   // inode cache
+  sfs_iinit();
   fat_iinit();
+  dcache_init();   // directory entry cache
+  pcache_init();   // file page cache
   ideinit();       // disk
+  vfs_init();      // mount table
   if(!ismp)
     timerinit();   // uniprocessor timer
   startothers();   // start other processors
@@ -87,7 +92,7 @@ startothers(void)
     // Tell entryother.S what stack to use, where to enter, and what 
     // pgdir to use. We cannot use kpgdir yet, because the AP processor
     // is running in low  memory, so we use entrypgdir for the APs too.
-    stack = kalloc();
+    stack = kallocpages(KSTACKORDER);
     *(void**)(code-4) = stack + KSTACKSIZE;
     *(void**)(code-8) = mpenter;
     *(int**)(code-12) = (void *) v2p(entrypgdir);
@@ -30,6 +30,13 @@ ideintr(void)
   // no-op
 }
 
+// Only disk 1 is simulated.
+int
+idepresent(uint dev)
+{
+  return dev == 1;
+}
+
 // Sync buf with disk. 
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
 // Else if B_VALID is not set, read buf from disk, set B_VALID.
@@ -55,4 +62,8 @@ iderw(struct buf *b)
   } else
     memmove(b->data, p, 512);
   b->flags |= B_VALID;
+  if(b->flags & B_ASYNC){
+    b->flags &= ~B_ASYNC;
+    brelse(b);
+  }
 }
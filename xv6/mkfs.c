@@ -13,10 +13,13 @@
 
 #define static_assert(a, b) do { switch (0) case 0: case (a): ; } while (0)
 
-int nblocks = 985;
-int nlog = LOGSIZE;
+int nsect = 2048;  // image size (sectors)
+int bsize = 1024;
+int spb;           // sectors per block
+int nblocks;
+int nlog;
 int ninodes = 200;
-int size = 1024;
+int size;
 
 int fsfd;
 struct sfs_super sb;
@@ -33,6 +36,8 @@ void rinode(uint inum, struct sfs_dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+uint bappend(struct sfs_dinode *din, uint fbn);
+uint blast(struct sfs_dinode *din);
 
 // convert to intel byte order
 ushort
@@ -69,10 +74,20 @@ main(int argc, char *argv[])
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
+  if(argc > 2 && strcmp(argv[1], "-b") == 0){
+    bsize = atoi(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
   if(argc < 2){
-    fprintf(stderr, "Usage: mkfs fs.img files...\n");
+    fprintf(stderr, "Usage: mkfs [-b bsize] fs.img files...\n");
+    exit(1);
+  }
+  if(bsize < 512 || bsize > MAXBSIZE || bsize % 512 != 0){
+    fprintf(stderr, "mkfs: bad block size %d\n", bsize);
     exit(1);
   }
+  spb = bsize / 512;
 
   assert((512 % sizeof(struct sfs_dinode)) == 0);
   assert((512 % sizeof(struct sfs_dirent)) == 0);
@@ -83,21 +98,28 @@ main(int argc, char *argv[])
     exit(1);
   }
 
+  // The log needs LOGSIZE sectors plus its header; the inodes and
+  // bitmap are rounded up to a whole number of blocks.
+  size = nsect / spb;
+  nlog = (LOGSIZE + 1 + spb - 1) / spb;
+  bitblocks = size/(512*8) + 1;
+  usedblocks = (ninodes / IPB + 3 + bitblocks + spb - 1) / spb;
+  freeblock = usedblocks;
+  nblocks = size - usedblocks - nlog;
+
   sb.size = xint(size);
-  sb.nblocks = xint(nblocks); // so whole disk is size sectors
+  sb.nblocks = xint(nblocks);
   sb.ninodes = xint(ninodes);
   sb.nlog = xint(nlog);
+  sb.bsize = xint(bsize);
 
-  bitblocks = size/(512*8) + 1;
-  usedblocks = ninodes / IPB + 3 + bitblocks;
-  freeblock = usedblocks;
-
-  printf("used %d (bit %d ninode %zu) free %u log %u total %d\n", usedblocks,
-         bitblocks, ninodes/IPB + 1, freeblock, nlog, nblocks+usedblocks+nlog);
+  printf("bsize %d: used %d (bit %d ninode %zu) free %u log %u total %d\n",
+         bsize, usedblocks, bitblocks, ninodes/IPB + 1, freeblock, nlog,
+         nblocks+usedblocks+nlog);
 
   assert(nblocks + usedblocks + nlog == size);
 
-  for(i = 0; i < nblocks + usedblocks + nlog; i++)
+  for(i = 0; i < nsect; i++)
     wsect(i, zeroes);
 
   memset(buf, 0, sizeof(buf));
@@ -148,7 +170,7 @@ main(int argc, char *argv[])
   // fix size of root inode dir
   rinode(rootino, &din);
   off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
+  off = ((off + bsize - 1) / bsize) * bsize;
   din.size = xint(off);
   winode(rootino, &din);
 
@@ -248,6 +270,88 @@ balloc(int used)
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// Return the last block of the file described by din.
+uint
+blast(struct sfs_dinode *din)
+{
+  struct sfs_extent *e;
+  struct sfs_extnode *node;
+  char leaf[512];
+  uint i;
+
+  node = (struct sfs_extnode*)leaf;
+  if(xint(din->exttree) != 0){
+    rsect(xint(din->exttree) * spb, leaf);
+    e = (struct sfs_extent*)(node + 1) + xint(node->nentries) - 1;
+  } else {
+    for(i = 0; i < NEXTENT && din->extents[i].len; i++)
+      ;
+    assert(i > 0);
+    e = &din->extents[i-1];
+  }
+  return xint(e->addr) + xint(e->len) - 1;
+}
+
+// Map file block fbn of din to a fresh block, which is returned.
+// Extents past the inline ones go in a single leaf of the extent
+// tree; that is plenty for the files mkfs writes.
+uint
+bappend(struct sfs_dinode *din, uint fbn)
+{
+  struct sfs_extent *e;
+  struct sfs_extnode *node;
+  char leaf[512];
+  uint x, n, i;
+
+  x = freeblock++;
+  usedblocks++;
+  node = (struct sfs_extnode*)leaf;
+  if(xint(din->exttree) != 0){
+    rsect(xint(din->exttree) * spb, leaf);
+    n = xint(node->nentries);
+    e = (struct sfs_extent*)(node + 1) + n - 1;
+    if(xint(e->addr) + xint(e->len) == x){
+      e->len = xint(xint(e->len) + 1);
+    } else {
+      assert(n < NEXTLEAF);
+      e++;
+      e->start = xint(fbn);
+      e->addr = xint(x);
+      e->len = xint(1);
+      node->nentries = xint(n + 1);
+    }
+    wsect(xint(din->exttree) * spb, leaf);
+    return x;
+  }
+
+  for(i = 0; i < NEXTENT && din->extents[i].len; i++)
+    ;
+  if(i > 0){
+    e = &din->extents[i-1];
+    if(xint(e->addr) + xint(e->len) == x){
+      e->len = xint(xint(e->len) + 1);
+      return x;
+    }
+  }
+  if(i < NEXTENT){
+    e = &din->extents[i];
+  } else {
+    din->exttree = xint(freeblock++);
+    usedblocks++;
+    bzero(leaf, sizeof(leaf));
+    node->magic = xshort(EXTMAGIC);
+    node->depth = xshort(0);
+    node->nentries = xint(1);
+    e = (struct sfs_extent*)(node + 1);
+  }
+  e->start = xint(fbn);
+  e->addr = xint(x);
+  e->len = xint(1);
+  if(din->exttree)
+    wsect(xint(din->exttree) * spb, leaf);
+  return x;
+}
+
 void
 iappend(uint inum, void *xp, int n)
 {
@@ -255,39 +359,22 @@ iappend(uint inum, void *xp, int n)
   uint fbn, off, n1;
   struct sfs_dinode din;
   char buf[512];
-  uint indirect[NINDIRECT];
   uint x;
 
   rinode(inum, &din);
 
   off = xint(din.size);
   while(n > 0){
-    fbn = off / 512;
+    fbn = off / bsize;
     assert(fbn < MAXFILE);
-    if(fbn < NDIRECT){
-      if(xint(din.addrs[fbn]) == 0){
-        din.addrs[fbn] = xint(freeblock++);
-        usedblocks++;
-      }
-      x = xint(din.addrs[fbn]);
-    } else {
-      if(xint(din.addrs[NDIRECT]) == 0){
-        // printf("allocate indirect block\n");
-        din.addrs[NDIRECT] = xint(freeblock++);
-        usedblocks++;
-      }
-      // printf("read indirect block\n");
-      rsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      if(indirect[fbn - NDIRECT] == 0){
-        indirect[fbn - NDIRECT] = xint(freeblock++);
-        usedblocks++;
-        wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      }
-      x = xint(indirect[fbn-NDIRECT]);
-    }
-    n1 = min(n, (fbn + 1) * 512 - off);
+    if(off % bsize == 0)
+      x = bappend(&din, fbn);
+    else
+      x = blast(&din);
+    x = x * spb + off % bsize / 512;
+    n1 = min(n, 512 - off % 512);
     rsect(x, buf);
-    bcopy(p, buf + off - (fbn * 512), n1);
+    bcopy(p, buf + off % 512, n1);
     wsect(x, buf);
     n -= n1;
     off += n1;
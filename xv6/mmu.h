@@ -139,6 +139,11 @@ struct segdesc {
 #define PTE_D           0x040   // Dirty
 #define PTE_PS          0x080   // Page Size
 #define PTE_MBZ         0x180   // Bits must be zero
+#define PTE_PC          0x200   // Page held from the file page cache (software)
+#define PTE_COW         0x400   // Copy page on first store (software)
+
+// Page fault error code bits.
+#define FEC_WR          0x002   // Fault was a store
 
 // Address in page table or page directory entry
 #define PTE_ADDR(pte)   ((uint)(pte) & ~0xFFF)
@@ -1,12 +1,18 @@
 #define NPROC        64  // maximum number of processes
-#define KSTACKSIZE 4096  // size of per-process kernel stack
+#define KSTACKORDER   1  // per-process kernel stack is 2^KSTACKORDER pages
+#define KSTACKSIZE (4096 << KSTACKORDER)
+#define MAXORDER     10  // largest kallocpages block is 2^MAXORDER pages
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NBUF         10  // size of disk block cache
-#define NINODE       50  // maximum number of active i-nodes
+#define NVMA          8  // file mappings per process
+#define SBRKRESERVE 128  // free pages sbrk leaves to the kernel
+#define NBUF         30  // disk block buffers made at boot
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
+#define FATDEV        2  // device number of the FAT disk mounted at boot
+#define NSFS          3  // maximum number of mounted SFS volumes
+#define NFAT          3  // maximum number of mounted FAT volumes
+#define NMOUNT        4  // maximum number of mounts
 #define MAXARG       32  // max exec arguments
-#define LOGSIZE      10  // max data sectors in on-disk log
+#define LOGSIZE      20  // max data sectors in on-disk log
 
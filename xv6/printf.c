@@ -1,15 +1,66 @@
 #include "types.h"
 #include "stat.h"
+#include "fcntl.h"
 #include "user.h"
 
+// Output of one printf, gathered for a single writev: runs of the
+// format and %s strings are pointed at where they are, and what has
+// to be formatted goes in text.
+struct pbuf {
+  int fd;
+  struct iovec iov[IOV_MAX];
+  int niov;
+  char text[64];
+  int ntext;
+};
+
 static void
-putc(int fd, char c)
+flush(struct pbuf *pb)
 {
-  write(fd, &c, 1);
+  if(pb->niov > 0)
+    writev(pb->fd, pb->iov, pb->niov);
+  pb->niov = 0;
+  pb->ntext = 0;
+}
+
+// Add the n bytes at s to the output.
+static void
+putstr(struct pbuf *pb, char *s, int n)
+{
+  struct iovec *v;
+
+  if(n == 0)
+    return;
+  if(pb->niov > 0){
+    v = &pb->iov[pb->niov - 1];
+    if((char*)v->iov_base + v->iov_len == s){
+      v->iov_len += n;
+      return;
+    }
+  }
+  if(pb->niov == IOV_MAX)
+    flush(pb);
+  v = &pb->iov[pb->niov++];
+  v->iov_base = s;
+  v->iov_len = n;
+}
+
+static void
+putc(struct pbuf *pb, char c)
+{
+  char *p;
+
+  // Make room first: putstr flushing after c is stored in text
+  // would leave it queued in a buffer that is then reused.
+  if(pb->ntext == sizeof(pb->text) || pb->niov == IOV_MAX)
+    flush(pb);
+  p = &pb->text[pb->ntext++];
+  *p = c;
+  putstr(pb, p, 1);
 }
 
 static void
-printint(int fd, int xx, int base, int sgn)
+printint(struct pbuf *pb, int xx, int base, int sgn)
 {
   static char digits[] = "0123456789ABCDEF";
   char buf[16];
@@ -32,17 +83,21 @@ printint(int fd, int xx, int base, int sgn)
     buf[i++] = '-';
 
   while(--i >= 0)
-    putc(fd, buf[i]);
+    putc(pb, buf[i]);
 }
 
 // Print to the given fd. Only understands %d, %x, %p, %s.
 void
 printf(int fd, char *fmt, ...)
 {
+  struct pbuf pb;
   char *s;
-  int c, i, state;
+  int c, i, j, state;
   uint *ap;
 
+  pb.fd = fd;
+  pb.niov = 0;
+  pb.ntext = 0;
   state = 0;
   ap = (uint*)(void*)&fmt + 1;
   for(i = 0; fmt[i]; i++){
@@ -51,35 +106,36 @@ printf(int fd, char *fmt, ...)
       if(c == '%'){
         state = '%';
       } else {
-        putc(fd, c);
+        for(j = i; fmt[j+1] && fmt[j+1] != '%'; j++)
+          ;
+        putstr(&pb, fmt + i, j + 1 - i);
+        i = j;
       }
     } else if(state == '%'){
       if(c == 'd'){
-        printint(fd, *ap, 10, 1);
+        printint(&pb, *ap, 10, 1);
         ap++;
       } else if(c == 'x' || c == 'p'){
-        printint(fd, *ap, 16, 0);
+        printint(&pb, *ap, 16, 0);
         ap++;
       } else if(c == 's'){
         s = (char*)*ap;
         ap++;
         if(s == 0)
           s = "(null)";
-        while(*s != 0){
-          putc(fd, *s);
-          s++;
-        }
+        putstr(&pb, s, strlen(s));
       } else if(c == 'c'){
-        putc(fd, *ap);
+        putc(&pb, *ap);
         ap++;
       } else if(c == '%'){
-        putc(fd, c);
+        putc(&pb, c);
       } else {
         // Unknown % sequence.  Print it to draw attention.
-        putc(fd, '%');
-        putc(fd, c);
+        putc(&pb, '%');
+        putc(&pb, c);
       }
       state = 0;
     }
   }
+  flush(&pb);
 }
@@ -52,7 +52,7 @@ found:
   release(&ptable.lock);
 
   // Allocate kernel stack.
-  if((p->kstack = kalloc()) == 0){
+  if((p->kstack = kallocpages(KSTACKORDER)) == 0){
     p->state = UNUSED;
     return 0;
   }
@@ -108,12 +108,25 @@ userinit(void)
 int
 growproc(int n)
 {
+  struct vma *v;
   uint sz;
   
   sz = proc->sz;
   if(n > 0){
-    if((sz = allocuvm(proc->pgdir, sz, sz + n)) == 0)
+    // The heap may not grow into a file mapping.
+    for(v = proc->vma; v < &proc->vma[NVMA]; v++)
+      if(v->f && v->start >= sz && sz + n > v->start)
+        return -1;
+    // Only the address space grows; vmfault enters
+    // the pages as they are first touched. Refuse more
+    // than free memory could back then, less what the
+    // kernel needs. Pages of earlier growth that have
+    // not been touched yet are not held back for it.
+    if(sz + n >= KERNBASE)
       return -1;
+    if((PGROUNDUP(sz + n) - PGROUNDUP(sz)) / PGSIZE + SBRKRESERVE > kfreecount())
+      return -1;
+    sz += n;
   } else if(n < 0){
     if((sz = deallocuvm(proc->pgdir, sz, sz + n)) == 0)
       return -1;
@@ -137,8 +150,11 @@ fork(void)
     return -1;
 
   // Copy process state from p.
-  if((np->pgdir = copyuvm(proc->pgdir, proc->sz)) == 0){
-    kfree(np->kstack);
+  if((np->pgdir = copyuvm(proc->pgdir, proc->sz)) == 0 || copyvmas(np) < 0){
+    if(np->pgdir)
+      freevm(np->pgdir);
+    np->pgdir = 0;
+    kfreepages(np->kstack, KSTACKORDER);
     np->kstack = 0;
     np->state = UNUSED;
     return -1;
@@ -173,6 +189,8 @@ exit(void)
   if(proc == initproc)
     panic("init exiting");
 
+  munmapall();
+
   // Close all open files.
   for(fd = 0; fd < NOFILE; fd++){
     if(proc->ofile[fd]){
@@ -223,7 +241,7 @@ wait(void)
       if(p->state == ZOMBIE){
         // Found one.
         pid = p->pid;
-        kfree(p->kstack);
+        kfreepages(p->kstack, KSTACKORDER);
         p->kstack = 0;
         freevm(p->pgdir);
         p->state = UNUSED;
@@ -259,16 +277,19 @@ void
 scheduler(void)
 {
   struct proc *p;
+  int ran;
 
   for(;;){
     // Enable interrupts on this processor.
     sti();
 
     // Loop over process table looking for process to run.
+    ran = 0;
     acquire(&ptable.lock);
     for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
       if(p->state != RUNNABLE)
         continue;
+      ran = 1;
       
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
@@ -284,6 +305,9 @@ scheduler(void)
     }
     release(&ptable.lock);
 
+    // Nothing to run: zero pages ahead of need.
+    if(!ran)
+      kzeroidle();
   }
 }
 
@@ -332,6 +356,7 @@ forkret(void)
     // be run from main().
     first = 0;
     initlog();
+    vfs_mount_boot();
   }
   
   // Return to "caller", actually trapret (see allocproc).
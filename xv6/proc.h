@@ -49,6 +49,18 @@ struct context {
   uint eip;
 };
 
+// A range of the address space mapped from a file by mmap.
+struct vma {
+  uint start;                  // First address, page-aligned
+  uint end;                    // Address after the last page
+  int prot;                    // PROT_READ, PROT_WRITE
+  int flags;                   // MAP_SHARED or MAP_PRIVATE
+  struct file *f;              // Mapped file; 0 if the slot is free
+  uint off;                    // File offset mapped at start
+  uint filesz;                 // Bytes from start backed by the file;
+                               // the rest reads as zeroes
+};
+
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -65,6 +77,7 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct vma vma[NVMA];        // File mappings
   char name[16];               // Process name (debugging)
 };
 
@@ -73,3 +86,4 @@ struct proc {
 //   original data and bss
 //   fixed-size stack
 //   expandable heap
+// File mappings are placed from KERNBASE down.
@@ -0,0 +1,245 @@
+// Object caches for kernel data structures smaller than a page.
+//
+// A cache hands out objects of one size, carved from slabs: pages
+// from kalloc, each with a struct slab at the front and as many
+// objects as fit after it. Free objects of a slab are linked
+// through their first word, and slabs with free objects are on
+// their cache's partial list.
+//
+// Each CPU has a magazine of free objects per cache, so that most
+// allocations and frees take only that CPU's lock. An empty
+// magazine is refilled from the slabs with half a magazine, and a
+// full one gives half back.
+//
+// A slab whose objects are all free again goes back to kalloc,
+// unless it is the cache's only empty one or the cache was made
+// with KC_KEEP. The memory of a KC_KEEP cache never leaves it, so
+// a pointer to a freed object still points at an object of the
+// same type; the inode cache relies on that.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "proc.h"
+
+#define NKCACHE 16  // number of caches
+#define KMAG    8   // objects in a CPU's magazine
+
+struct slab {
+  struct kcache *kc;
+  struct slab *prev;  // partial list
+  struct slab *next;
+  char *free;         // free objects
+  int inuse;          // objects allocated, magazines included
+};
+
+struct magazine {
+  struct spinlock lock;
+  int n;
+  void *obj[KMAG];
+  int nalloc;         // allocations less frees on this CPU
+};
+
+struct kcache {
+  char *name;
+  uint size;
+  int flags;
+  int perslab;          // objects in a slab
+  struct spinlock lock;
+  struct slab *partial; // slabs with free objects
+  int nempty;           // ... of which all free
+  uint nslab;           // slabs in the cache
+  struct magazine mag[NCPU];
+};
+
+static struct {
+  struct kcache cache[NKCACHE];
+  int n;
+} kcaches;
+
+// Make a cache of objects of size bytes. Caches are made
+// while the kernel boots, on one CPU.
+struct kcache*
+kcachecreate(char *name, uint size, int flags)
+{
+  struct kcache *kc;
+  int i;
+
+  // Objects must hold the free list link, and stay aligned.
+  if(size < sizeof(char*))
+    size = sizeof(char*);
+  size = (size + 3) & ~3;
+  if(size > PGSIZE - sizeof(struct slab))
+    panic("kcachecreate: size");
+
+  if(kcaches.n == NKCACHE)
+    panic("kcachecreate: too many");
+  kc = &kcaches.cache[kcaches.n++];
+
+  kc->name = name;
+  kc->size = size;
+  kc->flags = flags;
+  kc->perslab = (PGSIZE - sizeof(struct slab)) / size;
+  initlock(&kc->lock, name);
+  for(i = 0; i < NCPU; i++)
+    initlock(&kc->mag[i].lock, name);
+  return kc;
+}
+
+static void
+slabunlink(struct kcache *kc, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    kc->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+static void
+slabpush(struct kcache *kc, struct slab *s)
+{
+  s->prev = 0;
+  s->next = kc->partial;
+  if(s->next)
+    s->next->prev = s;
+  kc->partial = s;
+}
+
+// Make a new slab of free objects for kc. Caller holds kc->lock.
+static struct slab*
+slabgrow(struct kcache *kc)
+{
+  struct slab *s;
+  char *p;
+  int i;
+
+  if((s = (struct slab*)kalloc()) == 0)
+    return 0;
+  s->kc = kc;
+  s->inuse = 0;
+  s->free = 0;
+  p = (char*)(s + 1) + (kc->perslab - 1) * kc->size;
+  for(i = 0; i < kc->perslab; i++, p -= kc->size){
+    *(char**)p = s->free;
+    s->free = p;
+  }
+  slabpush(kc, s);
+  kc->nempty++;
+  kc->nslab++;
+  return s;
+}
+
+// Take up to n objects from the slabs of kc into obj.
+// Caller holds kc->lock.
+static int
+slabtake(struct kcache *kc, void **obj, int n)
+{
+  struct slab *s;
+  int got;
+
+  for(got = 0; got < n; got++){
+    if((s = kc->partial) == 0 && (s = slabgrow(kc)) == 0)
+      break;
+    if(s->inuse++ == 0)
+      kc->nempty--;
+    obj[got] = s->free;
+    s->free = *(char**)s->free;
+    if(s->free == 0)
+      slabunlink(kc, s);
+  }
+  return got;
+}
+
+// Return the n objects in obj to their slabs.
+// Caller holds kc->lock.
+static void
+slabgive(struct kcache *kc, void **obj, int n)
+{
+  struct slab *s;
+  int i;
+
+  for(i = 0; i < n; i++){
+    s = (struct slab*)PGROUNDDOWN((uint)obj[i]);
+    if(s->kc != kc)
+      panic("kcachefree");
+    if(s->free == 0)
+      slabpush(kc, s);
+    *(char**)obj[i] = s->free;
+    s->free = obj[i];
+    if(--s->inuse > 0)
+      continue;
+    if(kc->nempty > 0 && !(kc->flags & KC_KEEP)){
+      slabunlink(kc, s);
+      kc->nslab--;
+      kfree((char*)s);
+    } else
+      kc->nempty++;
+  }
+}
+
+// Allocate an object from kc. Its contents are whatever
+// the last user left there. Returns 0 if out of memory.
+void*
+kcachealloc(struct kcache *kc)
+{
+  struct magazine *m;
+  void *obj;
+
+  pushcli();
+  m = &kc->mag[cpu->id];
+  acquire(&m->lock);
+  if(m->n == 0){
+    acquire(&kc->lock);
+    m->n = slabtake(kc, m->obj, KMAG/2);
+    release(&kc->lock);
+  }
+  obj = 0;
+  if(m->n > 0){
+    obj = m->obj[--m->n];
+    m->nalloc++;
+  }
+  release(&m->lock);
+  popcli();
+  return obj;
+}
+
+// Free obj, which came from kcachealloc(kc).
+void
+kcachefree(struct kcache *kc, void *obj)
+{
+  struct magazine *m;
+
+  pushcli();
+  m = &kc->mag[cpu->id];
+  acquire(&m->lock);
+  if(m->n == KMAG){
+    acquire(&kc->lock);
+    slabgive(kc, m->obj + KMAG/2, KMAG/2);
+    release(&kc->lock);
+    m->n = KMAG/2;
+  }
+  m->obj[m->n++] = obj;
+  m->nalloc--;
+  release(&m->lock);
+  popcli();
+}
+
+// Print the caches to the console, for ^P.
+void
+kcachedump(void)
+{
+  struct kcache *kc;
+  int i, n;
+
+  for(kc = kcaches.cache; kc < kcaches.cache + kcaches.n; kc++){
+    n = 0;
+    for(i = 0; i < NCPU; i++)
+      n += kc->mag[i].nalloc;
+    cprintf("%s: size %d in use %d slabs %d\n",
+            kc->name, kc->size, n, kc->nslab);
+  }
+}
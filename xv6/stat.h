@@ -21,3 +21,26 @@ struct stat {
   uint size;   // Size of file in bytes
   int fstype;  
 };
+
+// Directory entry as returned by getdents. Records are packed one
+// after another; reclen is the distance to the next one.
+struct dirent {
+  uint ino;           // Inode number
+  uint off;           // Cookie for the entries after this one
+  ushort reclen;      // Length of this record
+  ushort namlen;      // Length of name, not counting the NUL
+  short type;         // T_DIR, T_FILE or T_DEV
+  char name[];        // NUL-terminated
+};
+
+#define DIRENT_RECLEN(namlen)  ((sizeof(struct dirent) + (namlen) + 1 + 3) & ~3)
+
+// Where find stopped: the directory it was reading at each level
+// below the starting one, and where in it to go on. Zero it to
+// start; depth is -1 once the walk is complete.
+#define FINDDEPTH 16
+
+struct findcursor {
+  int depth;
+  uint cookie[FINDDEPTH + 1];
+};
@@ -17,7 +17,7 @@
 int
 fetchint(uint addr, int *ip)
 {
-  if(addr >= proc->sz || addr+4 > proc->sz)
+  if(uvmaccess(addr, 4, 0) < 0)
     return -1;
   *ip = *(int*)(addr);
   return 0;
@@ -29,16 +29,15 @@ fetchint(uint addr, int *ip)
 int
 fetchstr(uint addr, char **pp)
 {
-  char *s, *ep;
+  char *s;
 
-  if(addr >= proc->sz)
-    return -1;
   *pp = (char*)addr;
-  ep = (char*)proc->sz;
-  for(s = *pp; s < ep; s++)
+  for(s = *pp; ; s++){
+    if((s == *pp || (uint)s % PGSIZE == 0) && uvmaccess((uint)s, 1, 0) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
-  return -1;
+  }
 }
 
 // Fetch the nth 32-bit system call argument.
@@ -58,7 +57,22 @@ argptr(int n, char **pp, int size)
   
   if(argint(n, &i) < 0)
     return -1;
-  if((uint)i >= proc->sz || (uint)i+size > proc->sz)
+  if(size < 0 || uvmaccess(i, size, 0) < 0)
+    return -1;
+  *pp = (char*)i;
+  return 0;
+}
+
+// As argptr, for a block the kernel is going to store into; pages
+// of read-only mappings are refused.
+int
+argwptr(int n, char **pp, int size)
+{
+  int i;
+
+  if(argint(n, &i) < 0)
+    return -1;
+  if(size < 0 || uvmaccess(i, size, 1) < 0)
     return -1;
   *pp = (char*)i;
   return 0;
@@ -66,8 +80,8 @@ argptr(int n, char **pp, int size)
 
 // Fetch the nth word-sized system call argument as a string pointer.
 // Check that the pointer is valid and the string is nul-terminated.
-// (There is no shared writable memory, so the string can't change
-// between this check and being used by the kernel.)
+// (A string in a shared file mapping can be changed by another
+// process between this check and being used by the kernel.)
 int
 argstr(int n, char **pp)
 {
@@ -106,6 +120,16 @@ extern int sys_getcwd(void);
 extern int sys_rmdir(void);
 extern int sys_touch(void);
 extern int sys_find(void);
+extern int sys_mount(void);
+extern int sys_umount(void);
+extern int sys_getdents(void);
+extern int sys_lseek(void);
+extern int sys_pread(void);
+extern int sys_pwrite(void);
+extern int sys_readv(void);
+extern int sys_writev(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -137,6 +161,16 @@ static int (*syscalls[])(void) = {
 [SYS_rmdir]   sys_rmdir,
 [SYS_touch]   sys_touch,
 [SYS_find]    sys_find,
+[SYS_mount]   sys_mount,
+[SYS_umount]  sys_umount,
+[SYS_getdents] sys_getdents,
+[SYS_lseek]   sys_lseek,
+[SYS_pread]   sys_pread,
+[SYS_pwrite]  sys_pwrite,
+[SYS_readv]   sys_readv,
+[SYS_writev]  sys_writev,
+[SYS_mmap]    sys_mmap,
+[SYS_munmap]  sys_munmap,
 };
 
 void
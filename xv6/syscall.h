@@ -28,3 +28,13 @@
 #define SYS_rmdir  27
 #define SYS_touch  28
 #define SYS_find   29
+#define SYS_mount  30
+#define SYS_umount 31
+#define SYS_getdents 32
+#define SYS_lseek  33
+#define SYS_pread  34
+#define SYS_pwrite 35
+#define SYS_readv  36
+#define SYS_writev 37
+#define SYS_mmap   38
+#define SYS_munmap 39
@@ -1,86 +1,71 @@
-// Simple grep.  Only supports ^ . * $ operators.
+// Print the last lines of a file.
+// Reads backwards from the end, so only the tail is read.
 
 #include "types.h"
 #include "stat.h"
+#include "fcntl.h"
 #include "user.h"
 
-char buf[1024];
+#define NLINES 10
+
+char buf[512];
 
 void
 tail(char* filepath)
 {
-  int fd, n, m, count;
-  char *p, *q;
-  memset(buf, 0, sizeof(char)*1024);
+  int fd, n, i, size, off, start, count;
+
   if((fd = open(filepath, 0)) < 0){
     printf(1, "tail: cannot open %s\n", filepath);
     exit();
   }
-  m = 0;
-  count = 0;
-  while((n = read(fd, buf+m, sizeof(buf)-m)) > 0){
-    m += n;
-    p = buf;
-    while((q = strchr(p, '\n')) != 0){
-      *q = 0;
-      p = q+1;
-      count++;
-    }
-    if(p == buf)
-      m = 0;
-    if(m > 0){
-      m -= p - buf;
-      memmove(buf, p, m);
-    }
+  if((size = lseek(fd, 0, SEEK_END)) < 0){
+    printf(1, "tail: cannot seek %s\n", filepath);
+    close(fd);
+    return;
   }
-  close(fd);
 
-  if((fd = open(filepath, 0)) < 0){
-    printf(1, "tail: cannot open %s\n", filepath);
-    exit();
-  }
-  if(count <= 10)
-  {
-    while((n = read(fd, buf, sizeof(buf))) > 0)
-      write(1, buf, n);
-    if(n < 0){
+  // Walk back from the end a block at a time, counting newlines,
+  // until the one before the last NLINES lines. A newline ending
+  // the file ends the last line rather than starting another.
+  start = 0;
+  count = 0;
+  for(off = size; off > 0 && start == 0; ){
+    n = off < sizeof(buf) ? off : sizeof(buf);
+    off -= n;
+    if(pread(fd, buf, n, off) != n){
       printf(1, "tail: read error\n");
+      close(fd);
+      return;
     }
-    return;
-  }
-  
-  m = 0;
-  while((n = read(fd, buf+m, sizeof(buf)-m)) > 0){
-    m += n;
-    p = buf;
-    while((q = strchr(p, '\n')) != 0){     
-      count--;
-      if(count < 10)
-      {
-        *q = '\n';
-        write(1, p, q+1 - p);
+    for(i = n - 1; i >= 0; i--){
+      if(buf[i] == '\n' && off + i != size - 1 && ++count == NLINES){
+        start = off + i + 1;
+        break;
       }
-      *q = 0; 
-      p = q+1;
-    }
-    if(p == buf)
-      m = 0;
-    if(m > 0){
-      m -= p - buf;
-      memmove(buf, p, m);
     }
   }
 
+  if(lseek(fd, start, SEEK_SET) != start){
+    printf(1, "tail: cannot seek %s\n", filepath);
+    close(fd);
+    return;
+  }
+  while((n = read(fd, buf, sizeof(buf))) > 0)
+    write(1, buf, n);
+  if(n < 0)
+    printf(1, "tail: read error\n");
+  close(fd);
 }
 
 int
 main(int argc, char *argv[])
-{ 
+{
   if(argc < 2){
     printf(2, "usage: tail filename ...\n");
     exit();
   }
-  
+
   tail(argv[1]);
   exit();
 }
@@ -79,6 +79,12 @@ trap(struct trapframe *tf)
             cpu->id, tf->cs, tf->eip);
     lapiceoi();
     break;
+
+  case T_PGFLT:
+    if(proc != 0 && (tf->cs&3) == DPL_USER && vmfault(rcr2(), tf->err & FEC_WR) == 0)
+      break;
+    // Not a page that can be supplied.
+    // fall through
    
   //PAGEBREAK: 13
   default:
@@ -1,4 +1,6 @@
 struct stat;
+struct findcursor;
+struct iovec;
 
 // system calls
 int fork(void);
@@ -29,7 +31,17 @@ int halt(void);
 int getcwd(char*, int);
 int rmdir(char*);
 int touch(char*);
-int find(char*, char*);
+int find(char*, char*, int, char*, int, struct findcursor*);
+int mount(int, char*, char*);
+int umount(char*);
+int getdents(int, void*, int);
+int lseek(int, int, int);
+int pread(int, void*, int, int);
+int pwrite(int, void*, int, int);
+int readv(int, struct iovec*, int);
+int writev(int, struct iovec*, int);
+void* mmap(void*, uint, int, int, int, int);
+int munmap(void*, uint);
 
 // ulib.c
 int stat(char*, struct stat*);
@@ -85,6 +85,10 @@ writetest(void)
   printf(stdout, "small file test ok\n");
 }
 
+// More blocks than fit in the inline extents, interleaved with
+// the directory's own growth, so the extent tree gets used.
+#define BIGBLOCKS 300
+
 void
 writetest1(void)
 {
@@ -98,7 +102,7 @@ writetest1(void)
     exit();
   }
 
-  for(i = 0; i < MAXFILE; i++){
+  for(i = 0; i < BIGBLOCKS; i++){
     ((int*)buf)[0] = i;
     if(write(fd, buf, 512) != 512){
       printf(stdout, "error: write big file failed\n", i);
@@ -118,7 +122,7 @@ writetest1(void)
   for(;;){
     i = read(fd, buf, 512);
     if(i == 0){
-      if(n == MAXFILE - 1){
+      if(n != BIGBLOCKS){
         printf(stdout, "read only %d blocks from big", n);
         exit();
       }
@@ -1186,6 +1190,661 @@ rmdot(void)
   printf(1, "rmdot ok\n");
 }
 
+// mount the FAT disk on a directory, look through it, and
+// take it off again.
+void
+mounttest(void)
+{
+  char buf[32];
+
+  printf(1, "mount test\n");
+  chdir("/");
+  if(mkdir("mnt") != 0){
+    printf(1, "mkdir mnt failed\n");
+    exit();
+  }
+  if(umount("/") == 0 || mount(1, "mnt", "sfs") == 0 || mount(2, "mnt", "nofs") == 0){
+    printf(1, "bad mount worked!\n");
+    exit();
+  }
+  if(umount("fat:") != 0 || mount(2, "mnt", "fat") != 0){
+    printf(1, "mount fat on mnt failed\n");
+    exit();
+  }
+  if(chdir("mnt") != 0 || getcwd(buf, sizeof(buf)) != 0 || strcmp(buf, "sfs:/mnt/") != 0){
+    printf(1, "cwd in mounted fat wrong\n");
+    exit();
+  }
+  if(umount("/mnt") == 0){
+    printf(1, "umount of busy volume worked!\n");
+    exit();
+  }
+  if(chdir("..") != 0 || getcwd(buf, sizeof(buf)) != 0 || strcmp(buf, "sfs:/") != 0){
+    printf(1, "chdir .. out of mounted fat failed\n");
+    exit();
+  }
+  if(umount("/mnt") != 0){
+    printf(1, "umount mnt failed\n");
+    exit();
+  }
+  // Put the FAT disk back by name, as it was at boot.
+  if(mount(2, "fat:", "fat") != 0 || mount(2, "fat:", "fat") == 0){
+    printf(1, "mount fat by name failed\n");
+    exit();
+  }
+  if(chdir("fat:/") != 0 || getcwd(buf, sizeof(buf)) != 0 || strcmp(buf, "fat:/") != 0 || chdir("sfs:/") != 0){
+    printf(1, "remounted fat not reachable\n");
+    exit();
+  }
+  if(unlink("mnt") != 0){
+    printf(1, "unlink mnt failed\n");
+    exit();
+  }
+  printf(1, "mount ok\n");
+}
+
+// getdents with a small buffer, across a hashed directory,
+// must return every entry exactly once.
+void
+getdentstest(void)
+{
+  char buf[64], name[8];
+  int fd, i, n, seen, ndots;
+  struct dirent *de;
+
+  printf(1, "getdents test\n");
+  if(mkdir("gdd") != 0 || chdir("gdd") != 0){
+    printf(1, "mkdir gdd failed\n");
+    exit();
+  }
+  name[0] = 'f';
+  name[3] = '\0';
+  for(i = 0; i < 40; i++){
+    name[1] = '0' + i / 10;
+    name[2] = '0' + i % 10;
+    if((fd = open(name, O_CREATE)) < 0){
+      printf(1, "create %s failed\n", name);
+      exit();
+    }
+    close(fd);
+  }
+  if((fd = open(".", 0)) < 0){
+    printf(1, "open gdd failed\n");
+    exit();
+  }
+  seen = 0;
+  ndots = 0;
+  while((n = getdents(fd, buf, sizeof(buf))) > 0){
+    for(i = 0; i < n; i += de->reclen){
+      de = (struct dirent*)(buf + i);
+      if(strcmp(de->name, ".") == 0 || strcmp(de->name, "..") == 0){
+        ndots++;
+        continue;
+      }
+      if(de->namlen != 3 || de->type != T_FILE || de->ino == 0){
+        printf(1, "getdents bad entry %s\n", de->name);
+        exit();
+      }
+      seen++;
+    }
+  }
+  close(fd);
+  if(n < 0 || seen != 40 || ndots != 2){
+    printf(1, "getdents saw %d entries\n", seen);
+    exit();
+  }
+  for(i = 0; i < 40; i++){
+    name[1] = '0' + i / 10;
+    name[2] = '0' + i % 10;
+    unlink(name);
+  }
+  if(chdir("..") != 0 || unlink("gdd") != 0){
+    printf(1, "unlink gdd failed\n");
+    exit();
+  }
+  printf(1, "getdents ok\n");
+}
+
+// find with a buffer that holds one path at a time
+// must resume where it stopped, inside a subdirectory.
+void
+findtest(void)
+{
+  struct findcursor cur;
+  char buf[16], start[16];
+  int n, found;
+
+  printf(1, "find test\n");
+  if(mkdir("fdt") != 0 || mkdir("fdt/sub") != 0){
+    printf(1, "mkdir fdt failed\n");
+    exit();
+  }
+  close(open("fdt/sub/x1", O_CREATE));
+  close(open("fdt/sub/y1", O_CREATE));
+  close(open("fdt/x2", O_CREATE));
+  memset(&cur, 0, sizeof(cur));
+  found = 0;
+  while((n = find("fdt", "x?", T_FILE, buf, sizeof(buf), &cur)) > 0){
+    if(strcmp(buf, "fdt/sub/x1") == 0)
+      found |= 1;
+    else if(strcmp(buf, "fdt/x2") == 0)
+      found |= 2;
+    else {
+      printf(1, "find returned %s\n", buf);
+      exit();
+    }
+  }
+  if(n < 0 || found != 3){
+    printf(1, "find failed\n");
+    exit();
+  }
+  // From a device path: results keep the device, and the
+  // path passed in is left alone.
+  strcpy(start, "sfs:/fdt");
+  memset(&cur, 0, sizeof(cur));
+  found = 0;
+  while((n = find(start, "x?", T_FILE, buf, sizeof(buf), &cur)) > 0){
+    if(strcmp(buf, "sfs:/fdt/sub/x1") == 0)
+      found |= 1;
+    else if(strcmp(buf, "sfs:/fdt/x2") == 0)
+      found |= 2;
+    else {
+      printf(1, "find returned %s\n", buf);
+      exit();
+    }
+  }
+  if(n < 0 || found != 3 || strcmp(start, "sfs:/fdt") != 0){
+    printf(1, "find from sfs:/fdt failed\n");
+    exit();
+  }
+  unlink("fdt/sub/x1");
+  unlink("fdt/sub/y1");
+  unlink("fdt/x2");
+  if(unlink("fdt/sub") != 0 || unlink("fdt") != 0){
+    printf(1, "unlink fdt failed\n");
+    exit();
+  }
+  printf(1, "find ok\n");
+}
+
+void
+movetest(void)
+{
+  int fd;
+  char buf[8];
+
+  printf(1, "move test\n");
+  if(mkdir("mvd") != 0){
+    printf(1, "mkdir mvd failed\n");
+    exit();
+  }
+  fd = open("mva", O_CREATE|O_RDWR);
+  write(fd, "moved", 5);
+  close(fd);
+  close(open("mvd/mvb", O_CREATE));
+  // Into a directory, replacing the file there.
+  if(move("mva", "mvd/mvb") != 0 || open("mva", 0) >= 0){
+    printf(1, "move mva failed\n");
+    exit();
+  }
+  // Into a directory, keeping the name.
+  if(move("mvd/mvb", ".") != 0 || (fd = open("mvb", 0)) < 0){
+    printf(1, "move mvb failed\n");
+    exit();
+  }
+  memset(buf, 0, sizeof(buf));
+  if(read(fd, buf, sizeof(buf)) != 5 || strcmp(buf, "moved") != 0){
+    printf(1, "moved file has wrong contents\n");
+    exit();
+  }
+  close(fd);
+  if(move("mvd", "mve") == 0){
+    printf(1, "move of a directory succeeded!\n");
+    exit();
+  }
+  if(unlink("mvb") != 0 || unlink("mvd") != 0){
+    printf(1, "unlink after move failed\n");
+    exit();
+  }
+  printf(1, "move ok\n");
+}
+
+void
+copytest(void)
+{
+  int fd, i, n;
+  char buf[512];
+
+  printf(1, "copy test\n");
+  fd = open("cpa", O_CREATE|O_RDWR);
+  for(i = 0; i < 40; i++){
+    memset(buf, 'a' + i % 26, sizeof(buf));
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(1, "write cpa failed\n");
+      exit();
+    }
+  }
+  write(fd, "end", 3);
+  close(fd);
+  // Many pages, so many transactions.
+  if(copy("cpa", "cpb") != 0){
+    printf(1, "copy cpa failed\n");
+    exit();
+  }
+  fd = open("cpb", 0);
+  for(i = 0; i < 40; i++){
+    if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(1, "read cpb failed\n");
+      exit();
+    }
+    for(n = 0; n < sizeof(buf); n++){
+      if(buf[n] != 'a' + i % 26){
+        printf(1, "cpb has wrong contents\n");
+        exit();
+      }
+    }
+  }
+  if(read(fd, buf, sizeof(buf)) != 3 || read(fd, buf, sizeof(buf)) != 0){
+    printf(1, "cpb has wrong size\n");
+    exit();
+  }
+  close(fd);
+  unlink("cpa");
+  unlink("cpb");
+  printf(1, "copy ok\n");
+}
+
+void
+seektest(void)
+{
+  int fd, fd1;
+  char buf[8];
+
+  printf(1, "seek test\n");
+  fd = open("skf", O_CREATE|O_RDWR);
+  write(fd, "hello", 5);
+  close(fd);
+  // Two appenders, each with an offset of 0.
+  fd = open("skf", O_RDWR|O_APPEND);
+  fd1 = open("skf", O_RDWR|O_APPEND);
+  if(write(fd, "a", 1) != 1 || write(fd1, "b", 1) != 1){
+    printf(1, "append failed\n");
+    exit();
+  }
+  if(lseek(fd, 0, SEEK_END) != 7 || lseek(fd, 1, SEEK_END) >= 0){
+    printf(1, "lseek SEEK_END failed\n");
+    exit();
+  }
+  if(pwrite(fd1, "J", 1, 0) != 1){
+    printf(1, "pwrite failed\n");
+    exit();
+  }
+  memset(buf, 0, sizeof(buf));
+  if(pread(fd, buf, sizeof(buf), 0) != 7 || strcmp(buf, "Jelloab") != 0){
+    printf(1, "pread got %s\n", buf);
+    exit();
+  }
+  memset(buf, 0, sizeof(buf));
+  if(lseek(fd, 2, SEEK_SET) != 2 || lseek(fd, 1, SEEK_CUR) != 3 ||
+     read(fd, buf, 2) != 2 || strcmp(buf, "lo") != 0){
+    printf(1, "lseek and read failed\n");
+    exit();
+  }
+  close(fd);
+  close(fd1);
+  unlink("skf");
+  printf(1, "seek ok\n");
+}
+
+void
+iovtest(void)
+{
+  int fd;
+  char a[4], b[8];
+  struct iovec iov[3];
+
+  printf(1, "iov test\n");
+  fd = open("iovf", O_CREATE|O_RDWR);
+  iov[0].iov_base = "abc";
+  iov[0].iov_len = 3;
+  iov[1].iov_base = "";
+  iov[1].iov_len = 0;
+  iov[2].iov_base = "defgh";
+  iov[2].iov_len = 5;
+  if(writev(fd, iov, 3) != 8){
+    printf(1, "writev failed\n");
+    exit();
+  }
+  close(fd);
+  fd = open("iovf", 0);
+  iov[0].iov_base = a;
+  iov[0].iov_len = sizeof(a);
+  iov[1].iov_base = b;
+  iov[1].iov_len = sizeof(b);
+  memset(b, 0, sizeof(b));
+  if(readv(fd, iov, 2) != 8 || a[0] != 'a' || a[3] != 'd' || strcmp(b, "efgh") != 0){
+    printf(1, "readv failed\n");
+    exit();
+  }
+  close(fd);
+  unlink("iovf");
+  printf(1, "iov ok\n");
+}
+
+// printf gathers its output for one writev: a format with more
+// runs than IOV_MAX, and more digits than its text buffer, must
+// still come out right.
+void
+printftest(void)
+{
+  static char want[] = "Z1519241307W1763105611Y362408565W709395707X780337198"
+    "WE2BB477Z10C4A44X62975YE96BX7Z48160Z18053X861FY5555W9"
+    "Z1239735321W3Z1W24B0C935Y44945D1F";
+  static char got[256];
+  int fd, n;
+
+  printf(1, "printf test\n");
+  fd = open("pff", O_CREATE|O_RDWR);
+  printf(fd, "Z%dW%dY%dW%dX%dW%xZ%xX%dY%xX%dZ%dZ%xX%xY%dW%dZ%dW%dZ%xW%xY%x",
+         1519241307, 1763105611, 362408565, 709395707, 780337198,
+         237745271, 17582660, 62975, 59755, 7, 48160, 98387, 34335,
+         5555, 9, 1239735321, 3, 1, 615565621, 1150573855);
+  close(fd);
+  fd = open("pff", 0);
+  n = read(fd, got, sizeof(got) - 1);
+  close(fd);
+  unlink("pff");
+  if(n != strlen(want) || strcmp(got, want) != 0){
+    printf(1, "printf wrote %s\n", got);
+    exit();
+  }
+  printf(1, "printf ok\n");
+}
+
+// The page cache must follow writes made through any descriptor or
+// mapping, and must not show a freed file's pages to the file that
+// gets its inode next.
+void
+pcachetest(void)
+{
+  int fd, fd2, i, n;
+  char *p;
+
+  printf(1, "pcache test\n");
+  fd = open("pcachef", O_CREATE|O_RDWR);
+  memset(buf, 'a', 5000);
+  if(write(fd, buf, 5000) != 5000){
+    printf(1, "pcache write failed\n");
+    exit();
+  }
+  fd2 = open("pcachef", O_RDONLY);
+  if(read(fd2, buf, 5000) != 5000){
+    printf(1, "pcache read failed\n");
+    exit();
+  }
+  p = mmap(0, 8192, PROT_READ, MAP_SHARED, fd2, 0);
+  if(p == MAP_FAILED || p[4500] != 'a'){
+    printf(1, "pcache mmap failed\n");
+    exit();
+  }
+  if(pwrite(fd, "bb", 2, 4095) != 2){
+    printf(1, "pcache pwrite failed\n");
+    exit();
+  }
+  if(pread(fd2, buf, 4, 4094) != 4 || buf[0] != 'a' || buf[1] != 'b' ||
+     buf[2] != 'b' || buf[3] != 'a'){
+    printf(1, "pcache read stale data\n");
+    exit();
+  }
+  if(p[4095] != 'b' || p[4096] != 'b'){
+    printf(1, "pcache mapping stale\n");
+    exit();
+  }
+  munmap(p, 8192);
+  close(fd);
+  close(fd2);
+  unlink("pcachef");
+
+  // Each file takes the inode the last one freed, with a new
+  // generation; there are more rounds than cache entries, so
+  // the old files' pages get recycled along the way.
+  for(i = 0; i < 100; i++){
+    fd = open("pcachef", O_CREATE|O_RDWR);
+    memset(buf, 'a' + i % 26, 100 + i);
+    if(write(fd, buf, 100 + i) != 100 + i){
+      printf(1, "pcache write failed\n");
+      exit();
+    }
+    close(fd);
+    fd = open("pcachef", O_RDONLY);
+    memset(buf, 0, 300);
+    n = read(fd, buf, 300);
+    close(fd);
+    if(n != 100 + i || buf[0] != 'a' + i % 26 || buf[n-1] != buf[0]){
+      printf(1, "pcache saw a freed file\n");
+      exit();
+    }
+    unlink("pcachef");
+  }
+  printf(1, "pcache ok\n");
+}
+
+// fork shares pages copy-on-write: stores by either side,
+// including the kernel's, must not show through to the other.
+void
+cowtest(void)
+{
+  static char page[4096];
+  int fd, pid, pfd[2];
+  char c;
+
+  printf(1, "cow test\n");
+  page[0] = 'p';
+  page[100] = 'p';
+  if(pipe(pfd) != 0){
+    printf(1, "pipe failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid == 0){
+    page[0] = 'c';
+    fd = open("README", 0);
+    if(read(fd, page + 100, 1) != 1 || page[100] == 'p'){
+      printf(1, "read into shared page failed\n");
+      exit();
+    }
+    close(fd);
+    write(pfd[1], page, 1);
+    exit();
+  }
+  page[100] = 'q';
+  if(read(pfd[0], &c, 1) != 1 || c != 'c'){
+    printf(1, "child store lost\n");
+    exit();
+  }
+  wait();
+  if(page[0] != 'p' || page[100] != 'q'){
+    printf(1, "child store showed through\n");
+    exit();
+  }
+  close(pfd[0]);
+  close(pfd[1]);
+  printf(1, "cow ok\n");
+}
+
+// Two instances of one program run at once, on the same
+// text pages from the page cache.
+void
+sharedtext(void)
+{
+  char *args[] = { "cat", 0 };
+  int in[2][2], out[2][2], pid, i, n, m;
+  char buf[4];
+
+  printf(1, "shared text test\n");
+  for(i = 0; i < 2; i++){
+    if(pipe(in[i]) != 0 || pipe(out[i]) != 0){
+      printf(1, "pipe() failed\n");
+      exit();
+    }
+    if((pid = fork()) < 0){
+      printf(1, "fork failed\n");
+      exit();
+    }
+    if(pid == 0){
+      close(0);
+      dup(in[i][0]);
+      close(1);
+      dup(out[i][1]);
+      close(in[i][0]);
+      close(in[i][1]);
+      close(out[i][0]);
+      close(out[i][1]);
+      if(i == 1){
+        close(in[0][1]);
+        close(out[0][0]);
+      }
+      exec("cat", args);
+      printf(1, "exec cat failed\n");
+      exit();
+    }
+    close(in[i][0]);
+    close(out[i][1]);
+  }
+  // Both are running now, each waiting for its input.
+  for(i = 0; i < 2; i++){
+    if(write(in[i][1], i ? "two" : "one", 3) != 3){
+      printf(1, "shared text write failed\n");
+      exit();
+    }
+  }
+  for(i = 0; i < 2; i++){
+    for(n = 0; n < 3; n += m){
+      if((m = read(out[i][0], buf + n, 3 - n)) <= 0){
+        printf(1, "shared text read failed\n");
+        exit();
+      }
+    }
+    if(buf[0] != (i ? 't' : 'o') || buf[2] != (i ? 'o' : 'e')){
+      printf(1, "shared text wrong output\n");
+      exit();
+    }
+    close(in[i][1]);
+  }
+  for(i = 0; i < 2; i++){
+    wait();
+    close(out[i][0]);
+  }
+  printf(1, "shared text ok\n");
+}
+
+void
+mmaptest(void)
+{
+  int fd, i, pid;
+  char *p;
+
+  printf(1, "mmap test\n");
+  fd = open("mmapf", O_CREATE|O_RDWR);
+  for(i = 0; i < 5000; i++)
+    buf[i] = 'a' + i % 26;
+  if(write(fd, buf, 5000) != 5000){
+    printf(1, "mmap write failed\n");
+    exit();
+  }
+  p = mmap(0, 5000, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED){
+    printf(1, "mmap failed\n");
+    exit();
+  }
+  if(p[0] != 'a' || p[4999] != buf[4999] || p[5000] != 0 || p[8191] != 0){
+    printf(1, "mmap wrong contents\n");
+    exit();
+  }
+  // The kernel reads from the mapping, and a child shares it.
+  if(pwrite(fd, p + 26, 3, 4096) != 3){
+    printf(1, "pwrite from mapping failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid == 0){
+    p[1] = 'Z';
+    exit();
+  }
+  wait();
+  p[4100] = 'Y';
+  if(munmap(p, 5000) != 0){
+    printf(1, "munmap failed\n");
+    exit();
+  }
+  if(pread(fd, buf, 5000, 0) != 5000 || buf[1] != 'Z' || buf[4096] != 'a' ||
+     buf[4098] != 'c' || buf[4100] != 'Y'){
+    printf(1, "mmap stores lost\n");
+    exit();
+  }
+
+  // Stores to a private mapping stay there.
+  p = mmap(0, 4096, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 4096);
+  if(p == MAP_FAILED || p[4] != 'Y'){
+    printf(1, "private mmap failed\n");
+    exit();
+  }
+  p[4] = 'X';
+  munmap(p, 4096);
+  if(pread(fd, buf, 1, 4100) != 1 || buf[0] != 'Y'){
+    printf(1, "private mmap reached the file\n");
+    exit();
+  }
+  close(fd);
+
+  fd = open("mmapf", O_RDONLY);
+  if(mmap(0, 4096, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0) != MAP_FAILED){
+    printf(1, "writable mmap of read-only fd succeeded\n");
+    exit();
+  }
+  close(fd);
+  unlink("mmapf");
+
+  // A shared mapping of more pages than the cache lets private
+  // mappings have is still shared with a child in every page.
+  fd = open("mmapf", O_CREATE|O_RDWR);
+  memset(buf, 0, 4096);
+  for(i = 0; i < 32; i++){
+    if(write(fd, buf, 4096) != 4096){
+      printf(1, "mmap write failed\n");
+      exit();
+    }
+  }
+  p = mmap(0, 32*4096, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED){
+    printf(1, "mmap failed\n");
+    exit();
+  }
+  for(i = 0; i < 32; i++){
+    if(p[i*4096] != 0){
+      printf(1, "mmap wrong contents\n");
+      exit();
+    }
+  }
+  pid = fork();
+  if(pid == 0){
+    for(i = 0; i < 32; i++)
+      p[i*4096] = 'a' + i;
+    exit();
+  }
+  wait();
+  for(i = 0; i < 32; i++){
+    if(p[i*4096] != 'a' + i){
+      printf(1, "shared mmap page not shared\n");
+      exit();
+    }
+  }
+  munmap(p, 32*4096);
+  close(fd);
+  unlink("mmapf");
+  printf(1, "mmap ok\n");
+}
+
 void
 dirfile(void)
 {
@@ -1317,6 +1976,185 @@ forktest(void)
   printf(1, "fork test OK\n");
 }
 
+// The number of pages sbrk will grow by at once, which follows
+// the free memory.
+int
+sbrkpages(void)
+{
+  int lo, hi, mid;
+
+  lo = 0;
+  hi = 65536;
+  while(lo < hi){
+    mid = (lo + hi + 1) / 2;
+    if(sbrk(mid*4096) == (char*)-1)
+      hi = mid - 1;
+    else {
+      sbrk(-mid*4096);
+      lo = mid;
+    }
+  }
+  return lo;
+}
+
+// Processes allocating and freeing pages at once, on all CPUs,
+// so that free pages go back and forth between the CPUs' lists
+// and the buddy lists; in one round the children take most of
+// memory, so that some CPUs find the buddy lists empty and take
+// from the others. All of it must be free again afterwards.
+void
+kalloctest(void)
+{
+  int before, after, round, i, j, n, pid;
+  char *p;
+
+  printf(1, "kalloc test\n");
+  before = sbrkpages();
+  for(round = 0; round < 5; round++){
+    n = round == 4 ? before / 10 : 200;
+    for(i = 0; i < 8; i++){
+      if((pid = fork()) < 0){
+        printf(1, "fork failed\n");
+        exit();
+      }
+      if(pid == 0){
+        if((p = sbrk(n*4096)) == (char*)-1){
+          printf(1, "kalloc test sbrk failed\n");
+          exit();
+        }
+        for(j = 0; j < n; j++)
+          p[j*4096] = j;
+        for(j = 0; j < n; j++){
+          if(p[j*4096] != (char)j){
+            printf(1, "kalloc test page shared\n");
+            exit();
+          }
+        }
+        exit();
+      }
+    }
+    for(i = 0; i < 8; i++)
+      wait();
+  }
+  after = sbrkpages();
+  if(after < before - 32){
+    printf(1, "kalloc test lost %d pages\n", before - after);
+    exit();
+  }
+  printf(1, "kalloc ok\n");
+}
+
+// More files and pipes open at once than the old fixed tables held
+// (100 files), from children that keep theirs open until all have
+// them. Their reads and writes go on at the same time, so that the
+// buffer cache may need more than its NBUF buffers too.
+void
+slabtest(void)
+{
+  int ready[2], go[2], pfd[3][2], fd[5], i, j, k, pid;
+  char name[4], b[512], c;
+
+  printf(1, "slab test\n");
+  if(pipe(ready) != 0 || pipe(go) != 0){
+    printf(1, "pipe() failed\n");
+    exit();
+  }
+  for(i = 0; i < 12; i++){
+    if((pid = fork()) < 0){
+      printf(1, "fork failed\n");
+      exit();
+    }
+    if(pid > 0)
+      continue;
+    // 0, 1, 2, ready[1] and go[0] leave room for 11 more.
+    close(ready[0]);
+    close(go[1]);
+    name[0] = 's';
+    name[1] = 'a' + i;
+    name[3] = '\0';
+    memset(b, 'a' + i, sizeof(b));
+    c = 'x';
+    for(j = 0; j < 5; j++){
+      name[2] = '0' + j;
+      if((fd[j] = open(name, O_CREATE|O_RDWR)) < 0){
+        c = 'f';
+        break;
+      }
+      for(k = 0; k < 4; k++)
+        write(fd[j], b, sizeof(b));
+    }
+    for(j = 0; c == 'x' && j < 3; j++)
+      if(pipe(pfd[j]) != 0)
+        c = 'f';
+    write(ready[1], &c, 1);
+    if(c != 'x')
+      exit();
+    read(go[0], &c, 1);
+    for(j = 0; j < 3; j++){
+      c = 'A' + j;
+      if(write(pfd[j][1], &c, 1) != 1 || read(pfd[j][0], &c, 1) != 1 || c != 'A' + j){
+        printf(1, "slab test pipe failed\n");
+        exit();
+      }
+    }
+    for(j = 0; j < 5; j++){
+      for(k = 0; k < 4; k++){
+        if(pread(fd[j], b, sizeof(b), k * sizeof(b)) != sizeof(b) ||
+           b[0] != 'a' + i || b[sizeof(b)-1] != 'a' + i){
+          printf(1, "slab test read failed\n");
+          exit();
+        }
+      }
+      close(fd[j]);
+      name[2] = '0' + j;
+      unlink(name);
+    }
+    exit();
+  }
+  close(ready[1]);
+  close(go[0]);
+  for(i = 0; i < 12; i++){
+    if(read(ready[0], &c, 1) != 1 || c != 'x'){
+      printf(1, "slab test child could not open its files\n");
+      exit();
+    }
+  }
+  close(go[1]);
+  for(i = 0; i < 12; i++)
+    wait();
+  close(ready[0]);
+  printf(1, "slab ok\n");
+}
+
+// Heap pages come from the pool of pages zeroed while CPUs are
+// idle, or are zeroed when taken; either way no byte of what the
+// pages held before may show.
+void
+zerotest(void)
+{
+  char *p;
+  int i, j;
+
+  printf(1, "zero test\n");
+  for(j = 0; j < 2; j++){
+    if((p = sbrk(64*4096)) == (char*)-1){
+      printf(1, "zero test sbrk failed\n");
+      exit();
+    }
+    for(i = 0; i < 64*4096; i++){
+      if(p[i] != 0){
+        printf(1, "zero test page not zeroed\n");
+        exit();
+      }
+      p[i] = 0xa5;
+    }
+    sbrk(-64*4096);
+    // Give the idle loop time to refill the pool.
+    sleep(10);
+  }
+  printf(1, "zero ok\n");
+}
+
 void
 sbrktest(void)
 {
@@ -1650,7 +2488,22 @@ main(int argc, char *argv[])
   sharedfd();
   dirfile();
   iref();
+  mounttest();
+  getdentstest();
+  findtest();
+  movetest();
+  copytest();
+  seektest();
+  iovtest();
+  printftest();
+  pcachetest();
+  sharedtext();
+  mmaptest();
+  cowtest();
   forktest();
+  kalloctest();
+  slabtest();
+  zerotest();
   bigdir(); // slow
 
   exectest();
@@ -6,6 +6,9 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "stat.h"
+#include "fcntl.h"
+#include "file.h"
 #include "inode.h"
 
 extern char data[];  // defined by kernel.ld
@@ -53,10 +56,9 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
   if(*pde & PTE_P){
     pgtab = (pte_t*)p2v(PTE_ADDR(*pde));
   } else {
-    if(!alloc || (pgtab = (pte_t*)kalloc()) == 0)
-      return 0;
     // Make sure all those PTE_P bits are zero.
-    memset(pgtab, 0, PGSIZE);
+    if(!alloc || (pgtab = (pte_t*)kzalloc()) == 0)
+      return 0;
     // The permissions here are overly generous, but they can
     // be further restricted by the permissions in the page table 
     // entries, if necessary.
@@ -132,9 +134,8 @@ setupkvm(void)
   pde_t *pgdir;
   struct kmap *k;
 
-  if((pgdir = (pde_t*)kalloc()) == 0)
+  if((pgdir = (pde_t*)kzalloc()) == 0)
     return 0;
-  memset(pgdir, 0, PGSIZE);
   if (p2v(PHYSTOP) > (void*)DEVSPACE)
     panic("PHYSTOP too high");
   for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
@@ -186,8 +187,7 @@ inituvm(pde_t *pgdir, char *init, uint sz)
   
   if(sz >= PGSIZE)
     panic("inituvm: more than a page");
-  mem = kalloc();
-  memset(mem, 0, PGSIZE);
+  mem = kzalloc();
   mappages(pgdir, 0, PGSIZE, v2p(mem), PTE_W|PTE_U);
   memmove(mem, init, sz);
 }
@@ -231,13 +231,12 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 
   a = PGROUNDUP(oldsz);
   for(; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    mem = kzalloc();
     if(mem == 0){
       cprintf("allocuvm out of memory\n");
       deallocuvm(pgdir, newsz, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     mappages(pgdir, (char*)a, PGSIZE, v2p(mem), PTE_W|PTE_U);
   }
   return newsz;
@@ -260,13 +259,16 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   for(; a  < oldsz; a += PGSIZE){
     pte = walkpgdir(pgdir, (char*)a, 0);
     if(!pte)
-      a += (NPTENTRIES - 1) * PGSIZE;
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
     else if((*pte & PTE_P) != 0){
       pa = PTE_ADDR(*pte);
       if(pa == 0)
         panic("kfree");
       char *v = p2v(pa);
-      kfree(v);
+      if(*pte & PTE_PC)
+        pcache_unmap(v);
+      else
+        kfree(v);
       *pte = 0;
     }
   }
@@ -305,34 +307,57 @@ clearpteu(pde_t *pgdir, char *uva)
   *pte &= ~PTE_U;
 }
 
-// Given a parent process's page table, create a copy
-// of it for a child.
+// Enter the page of the current process's *pte at va in page table
+// d too. Pages of the page cache are shared as they are, mapped
+// shared; others are shared read-only and copied on the first store
+// through either mapping.
+static int
+sharepage(pde_t *d, pte_t *pte, uint va)
+{
+  char *pg;
+
+  pg = p2v(PTE_ADDR(*pte));
+  if(*pte & PTE_PC)
+    pcache_dup(pg);
+  else {
+    if(*pte & PTE_W)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
+    kdup(pg);
+  }
+  if(mappages(d, (void*)va, PGSIZE, v2p(pg), PTE_FLAGS(*pte)) < 0){
+    if(*pte & PTE_PC)
+      pcache_unmap(pg);
+    else
+      kfree(pg);
+    return -1;
+  }
+  return 0;
+}
+
+// Given the current process's page table, create a copy
+// of it for a child, sharing the pages copy-on-write.
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
   pde_t *d;
   pte_t *pte;
-  uint pa, i, flags;
-  char *mem;
+  uint i;
 
   if((d = setupkvm()) == 0)
     return 0;
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
-    if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
-    pa = PTE_ADDR(*pte);
-    flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto bad;
-    memmove(mem, (char*)p2v(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, v2p(mem), flags) < 0)
+    // Heap pages not yet touched are not there to share.
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0 || !(*pte & PTE_P))
+      continue;
+    if(sharepage(d, pte, i) < 0)
       goto bad;
   }
+  // The parent's pages are now read-only.
+  lcr3(v2p(pgdir));
   return d;
 
 bad:
+  lcr3(v2p(pgdir));
   freevm(d);
   return 0;
 }
@@ -377,3 +402,348 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
   }
   return 0;
 }
+
+//PAGEBREAK!
+// File mappings. mmap places each one in the highest free range
+// below KERNBASE, and exec maps the segments of a program where
+// they belong; no pages are entered, they are faulted in. Pages
+// of the file page cache are mapped directly where the cache can
+// spare them, read-only in a private mapping until its first store
+// copies the page; otherwise the data is read into a page of the
+// process's own.
+
+// Return the mapping of the current process containing va, or 0.
+static struct vma*
+findvma(uint va)
+{
+  struct vma *v;
+
+  for(v = proc->vma; v < &proc->vma[NVMA]; v++)
+    if(v->f && va >= v->start && va < v->end)
+      return v;
+  return 0;
+}
+
+// Give the current process its own copy of the copy-on-write page
+// of *pte, or just make the page writable if it has the only
+// reference to it.
+static int
+cowpage(pte_t *pte)
+{
+  char *pg, *mem;
+
+  pg = p2v(PTE_ADDR(*pte));
+  if(!(*pte & PTE_PC) && krefs(pg) == 1){
+    *pte = (*pte & ~PTE_COW) | PTE_W;
+  } else {
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, pg, PGSIZE);
+    if(*pte & PTE_PC)
+      pcache_unmap(pg);
+    else
+      kfree(pg);
+    *pte = v2p(mem) | (PTE_FLAGS(*pte) & ~(PTE_PC|PTE_COW)) | PTE_W;
+  }
+  lcr3(v2p(proc->pgdir));
+  return 0;
+}
+
+// Read the page at va of mapping v into the current process, for a
+// store if write is set.
+static int
+mapfault(struct vma *v, uint va, int write)
+{
+  struct inode *ip;
+  struct stat st;
+  pte_t *pte;
+  char *mem;
+  uint off, n;
+  int perm;
+
+  if(write && !(v->prot & PROT_WRITE))
+    return -1;
+  if((pte = walkpgdir(proc->pgdir, (char*)va, 1)) == 0)
+    return -1;
+  perm = (v->prot & PROT_WRITE) ? PTE_W : 0;
+  if(va - v->start >= v->filesz){
+    // Beyond the file's part, e.g. the bss of a program.
+    if((mem = kzalloc()) == 0)
+      return -1;
+    *pte = v2p(mem) | perm | PTE_P | PTE_U;
+    return 0;
+  }
+
+  ip = v->f->ip;
+  off = v->off + (va - v->start);
+  vop_ilock_shared(ip);
+  vop_fstat(ip, &st);
+  if(off >= st.size){
+    vop_iunlock(ip);
+    return -1;
+  }
+  // Only a page that the mapping's file part covers
+  // to the end can be the cache's page. A shared mapping
+  // has no other page to use: a copy would not be shared.
+  mem = 0;
+  if(((v->flags & MAP_SHARED) || !write) && va - v->start + PGSIZE <= v->filesz)
+    mem = pcache_map(ip, off / PGSIZE, v->flags & MAP_SHARED);
+  if(mem == 0 && (v->flags & MAP_SHARED)){
+    vop_iunlock(ip);
+    return -1;
+  }
+  if(mem){
+    perm = PTE_PC;
+    if(v->prot & PROT_WRITE)
+      perm |= (v->flags & MAP_SHARED) ? PTE_W : PTE_COW;
+  } else {
+    if((mem = kalloc()) == 0){
+      vop_iunlock(ip);
+      return -1;
+    }
+    n = PGSIZE;
+    if(v->filesz - (va - v->start) < n)
+      n = v->filesz - (va - v->start);
+    if(st.size - off < n)
+      n = st.size - off;
+    memset(mem + n, 0, PGSIZE - n);
+    if(vop_read(ip, mem, off, n) != n){
+      vop_iunlock(ip);
+      kfree(mem);
+      return -1;
+    }
+  }
+  vop_iunlock(ip);
+  *pte = v2p(mem) | perm | PTE_P | PTE_U;
+  return 0;
+}
+
+// Supply the page at user address va of the current process, for a
+// store if write is set. Returns 0 if the access can be retried,
+// -1 if the process may not make it.
+int
+vmfault(uint va, int write)
+{
+  struct vma *v;
+  pte_t *pte;
+  char *mem;
+
+  if(va >= KERNBASE)
+    return -1;
+  va = PGROUNDDOWN(va);
+  pte = walkpgdir(proc->pgdir, (char*)va, 0);
+  if(pte && (*pte & PTE_P)){
+    if(!(*pte & PTE_U))
+      return -1;
+    if(!write || (*pte & PTE_W))
+      return 0;
+    if(*pte & PTE_COW)
+      return cowpage(pte);
+    return -1;
+  }
+  if((v = findvma(va)) != 0)
+    return mapfault(v, va, write);
+  if(va >= proc->sz)
+    return -1;
+  // A heap page sbrk has not entered yet.
+  if((mem = kzalloc()) == 0)
+    return -1;
+  if((pte = walkpgdir(proc->pgdir, (char*)va, 1)) == 0){
+    kfree(mem);
+    return -1;
+  }
+  *pte = v2p(mem) | PTE_P | PTE_W | PTE_U;
+  return 0;
+}
+
+// Check that the n bytes at user address va belong to the current
+// process, faulting in any of their pages that are not there yet,
+// and if write is set copying any copy-on-write pages among them,
+// so that the kernel can use them.
+int
+uvmaccess(uint va, uint n, int write)
+{
+  uint a, last;
+
+  if(va + n < va)
+    return -1;
+  last = n > 0 ? va + n - 1 : va;
+  for(a = PGROUNDDOWN(va); a <= last; a += PGSIZE)
+    if(vmfault(a, write) < 0)
+      return -1;
+  return 0;
+}
+
+// Map len bytes of file f from offset off into the current process.
+// Returns the address of the mapping, or -1.
+int
+mmap(struct file *f, uint len, int prot, int flags, uint off)
+{
+  struct vma *v, *w;
+  uint end;
+  int i;
+
+  if(f->type != FD_INODE || len == 0 || len > KERNBASE || off % PGSIZE != 0)
+    return -1;
+  if(flags != MAP_SHARED && flags != MAP_PRIVATE)
+    return -1;
+  if(!f->readable || (flags == MAP_SHARED && (prot & PROT_WRITE) && !f->writable))
+    return -1;
+  vop_ilock_shared(f->ip);
+  i = vop_gettype(f->ip);
+  vop_iunlock(f->ip);
+  if(i != T_FILE)
+    return -1;
+  for(v = proc->vma; v < &proc->vma[NVMA] && v->f; v++)
+    ;
+  if(v == &proc->vma[NVMA])
+    return -1;
+
+  // Move end down past every mapping the range would overlap.
+  len = PGROUNDUP(len);
+  end = KERNBASE;
+  for(i = 0; i < NVMA; i++){
+    w = &proc->vma[i];
+    if(w->f && w->start < end && w->end > end - len){
+      end = w->start;
+      i = -1;
+    }
+    if(end < len)
+      return -1;
+  }
+  if(end - len < PGROUNDUP(proc->sz))
+    return -1;
+
+  v->start = end - len;
+  v->end = end;
+  v->prot = prot;
+  v->flags = flags;
+  v->off = off;
+  v->filesz = len;
+  v->f = filedup(f);
+  return v->start;
+}
+
+// Remove the pages of mapping v from start to end from the current
+// process. Pages a shared mapping has stored to are written back,
+// each in its own transaction, as far as the file now extends.
+static void
+unmapvma(struct vma *v, uint start, uint end)
+{
+  struct inode *ip;
+  struct stat st;
+  pte_t *pte;
+  char *pg;
+  uint a, off, n;
+
+  ip = v->f->ip;
+  for(a = start; a < end; a += PGSIZE){
+    if((pte = walkpgdir(proc->pgdir, (char*)a, 0)) == 0 || !(*pte & PTE_P))
+      continue;
+    pg = p2v(PTE_ADDR(*pte));
+    if((v->flags & MAP_SHARED) && (*pte & PTE_D)){
+      off = v->off + (a - v->start);
+      begin_trans();
+      vop_ilock(ip);
+      vop_fstat(ip, &st);
+      if(off < st.size){
+        n = st.size - off < PGSIZE ? st.size - off : PGSIZE;
+        vop_write(ip, pg, off, n);
+      }
+      vop_iunlock(ip);
+      commit_trans();
+    }
+    if(*pte & PTE_PC)
+      pcache_unmap(pg);
+    else
+      kfree(pg);
+    *pte = 0;
+  }
+  lcr3(v2p(proc->pgdir));
+}
+
+// Unmap the pages from addr to addr+len, which must be the start,
+// the end or the whole of one mapping.
+int
+munmap(uint addr, uint len)
+{
+  struct vma *v;
+  uint end;
+
+  if(addr % PGSIZE != 0 || len == 0 || len > KERNBASE || addr + len < addr)
+    return -1;
+  // Rounding up must not wrap past the top of memory.
+  end = PGROUNDUP(addr + len);
+  if(end <= addr || (v = findvma(addr)) == 0 || end > v->end)
+    return -1;
+  if(addr != v->start && end != v->end)
+    return -1;
+  unmapvma(v, addr, end);
+  if(addr == v->start){
+    v->off += end - addr;
+    v->start = end;
+  } else
+    v->end = addr;
+  if(v->start == v->end){
+    fileclose(v->f);
+    v->f = 0;
+  }
+  return 0;
+}
+
+// Remove all the mappings of the current process.
+void
+munmapall(void)
+{
+  struct vma *v;
+
+  for(v = proc->vma; v < &proc->vma[NVMA]; v++){
+    if(v->f){
+      unmapvma(v, v->start, v->end);
+      fileclose(v->f);
+      v->f = 0;
+    }
+  }
+}
+
+// Give child process np the mappings of the current process, with
+// their pages shared as copyuvm shares them.
+int
+copyvmas(struct proc *np)
+{
+  struct vma *v;
+  pte_t *pte;
+  uint a;
+  int i;
+
+  for(i = 0; i < NVMA; i++){
+    v = &proc->vma[i];
+    if(v->f == 0)
+      continue;
+    np->vma[i] = *v;
+    np->vma[i].f = filedup(v->f);
+    // Pages below proc->sz, of the program's own
+    // segments, are shared by copyuvm.
+    for(a = v->start; a < v->end; a += PGSIZE){
+      if(a < proc->sz)
+        continue;
+      if((pte = walkpgdir(proc->pgdir, (char*)a, 0)) == 0 || !(*pte & PTE_P))
+        continue;
+      if(sharepage(np->pgdir, pte, a) < 0)
+        goto bad;
+    }
+  }
+  lcr3(v2p(proc->pgdir));
+  return 0;
+
+bad:
+  lcr3(v2p(proc->pgdir));
+  // The pages already entered go with np->pgdir.
+  for(i = 0; i < NVMA; i++){
+    if(np->vma[i].f){
+      fileclose(np->vma[i].f);
+      np->vma[i].f = 0;
+    }
+  }
+  return -1;
+}
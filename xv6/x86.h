@@ -117,6 +117,17 @@ sti(void)
   asm volatile("sti");
 }
 
+// Add n to *addr atomically; return the old value.
+static inline int
+xadd(volatile int *addr, int n)
+{
+  asm volatile("lock; xaddl %0, %1" :
+               "+r" (n), "+m" (*addr) :
+               :
+               "cc");
+  return n;
+}
+
 static inline uint
 xchg(volatile uint *addr, uint newval)
 {